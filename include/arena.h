@@ -2,17 +2,17 @@
 #define ARENA_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define DYNARRAY_CAPACITY_LIMIT 65536
 
-// TODO: Could use arena
-#define arena_append(l, x)                                                                                  \
-    do {                                                                                                    \
-        if ((l)->count == (l)->capacity) {                                                                  \
-            (l)->capacity = (l)->capacity == 0 ? 64 : (l)->capacity * 2;                                    \
-            (l)->items = arena_realloc(interpreter_arena, (l)->items, sizeof(*(l)->items) * (l)->capacity); \
-        }                                                                                                   \
-        (l)->items[(l)->count++] = (x);                                                                     \
+#define arena_append(a, l, x)                                                                \
+    do {                                                                                     \
+        if ((l)->count == (l)->capacity) {                                                   \
+            (l)->capacity = (l)->capacity == 0 ? 64 : (l)->capacity * 2;                     \
+            (l)->items = arena_realloc((a), (l)->items, sizeof(*(l)->items) * (l)->capacity); \
+        }                                                                                    \
+        (l)->items[(l)->count++] = (x);                                                      \
     } while (0)
 
 #define append(l, x)                                                               \
@@ -26,29 +26,98 @@
 
 #define pop(l) (l)->items[--(l)->count]
 
+#define ARENA_ALIGNMENT 16
+// Blocks under 512 bytes have one free list per size, larger ones one per power of two
+#define ARENA_SMALL_CLASSES 32
+#define ARENA_SMALL_LIMIT (ARENA_SMALL_CLASSES * ARENA_ALIGNMENT)
+#define ARENA_CLASS_COUNT 64
+
+// Every block starts with its size and the size of the block before it. The
+// previous size is the boundary tag that lets a freed block reach both of its
+// neighbours without walking any list.
 typedef struct {
-    size_t block_size;
-    size_t padding;
+    // Low bit is set while the block is allocated
+    size_t size;
+    // 0 for the first block of the arena
+    size_t prev_size;
 } arena_block_header;
 
 typedef struct arena_block {
-    size_t block_size;
+    arena_block_header header;
     struct arena_block *next;
+    struct arena_block *prev;
 } arena_block;
 
+// Counters updated on every allocation, build with -DARENA_STATS to get them.
+// Without it they are not in the arena at all and cost nothing.
 typedef struct {
+    size_t allocs;
+    size_t frees;
+    // Highest value of used
+    size_t peak;
+    // Allocations and their bytes, with the same classes as the free lists
+    size_t class_allocs[ARENA_CLASS_COUNT];
+    size_t class_bytes[ARENA_CLASS_COUNT];
+} arena_counters;
+
+// Snapshot from arena_get_stats, the free list part is computed on demand
+typedef struct {
+    size_t used;
+    size_t committed;
+    size_t limit;
+    size_t free_blocks;
+    size_t free_bytes;
+    size_t largest_free;
+    // Percentage of free memory outside of the largest free block, 0 when it is all in one piece
+    int fragmentation;
+    bool has_counters;
+    arena_counters counters;
+} arena_stats;
+
+typedef struct arena arena;
+
+struct arena {
+    // Address space is reserved once and committed chunk by chunk, size is the
+    // committed part and never goes past limit
     char *content;
     size_t size;
+    size_t reserved;
+    size_t limit;
     size_t used;
 
-    arena_block *head;
-} arena;
+    // Start of the space that was never handed out, a header there keeps the
+    // size of the last block like for any other block
+    arena_block_header *top;
+    arena_block *free_lists[ARENA_CLASS_COUNT];
+    // Bit i is set when free_lists[i] is not empty
+    uint64_t free_classes;
+
+    // Called when an allocation would go past the limit, the allocation fails if it returns
+    void (*on_exhausted)(arena *a, size_t size);
+
+#ifdef ARENA_STATS
+    arena_counters counters;
+#endif
+};
 
-#define ARENA_DEFAULT_SIZE (4 * 1024 * 1024)
+#define ARENA_RESERVE_SIZE ((size_t)1 << 30)
+#define ARENA_CHUNK_SIZE ((size_t)1 << 20)
+#define ARENA_DEFAULT_LIMIT ((size_t)256 << 20)
 
 arena *arena_default();
+// Rounded up to a whole chunk and capped by the reservation, it cannot go under what is committed
+void arena_set_limit(arena *a, size_t limit);
+// Frees every allocation at once, the committed pages stay for the next ones
+void arena_clear(arena *a);
+// Same but the committed pages are given back to the system, only one chunk stays committed
+void arena_reset(arena *a);
+// Walks the free lists, meant for reporting and not for hot paths
+arena_stats arena_get_stats(arena *a);
+// Smallest block size counted in a class
+size_t arena_class_size(size_t class);
 void *arena_alloc(arena *a, size_t size);
 void *arena_realloc(arena *a, void *ptr, size_t size);
+char *arena_strdup(arena *a, const char *s);
 void arena_free_node(arena *a, void *ptr);
 void arena_free(arena *a);
 
@@ -1,22 +1,98 @@
 #ifndef BASIC_H
 #define BASIC_H
 
+#include "arena.h"
+#include <stddef.h>
 #include <stdint.h>
 typedef struct basic_interpreter basic_interpreter;
+// Every program runs in its own context, any number of them can coexist
+typedef struct basic_interpreter basic_ctx;
 
-bool interpreter_init(const char *src, void (*print_fn)(const char *), void (*append_fn)(const char *));
-void advance_interpreter_time(float time);
-bool step_program();
-void interpreter_destroy();
+typedef enum { VAL_NUM, VAL_STRING, VAL_FIXED, VAL_TABLE } value_type;
 
-void register_function(const char *name, void (*f)(), int arg_count);
-void register_variable_int(const char *name, int value);
-void register_variable_string(const char *name, const char *value);
+// Values are packed in 8 bytes: the type tag lives in the upper 16 bits and the
+// payload in the lower 48 bits. User space pointers on x86_64 and aarch64 fit in
+// 48 bits, numbers are stored sign-agnostic in the low bits.
+typedef uint64_t value;
 
-void basic_push_int(int result);
-void basic_push_string(const char *s);
-int16_t basic_pop_value_num();
-const char *basic_pop_value_string();
-void basic_sleep(float seconds);
+#define VALUE_TAG_SHIFT 48
+#define VALUE_PAYLOAD_MASK ((UINT64_C(1) << VALUE_TAG_SHIFT) - 1)
+
+#define VALUE_TYPE(v) ((value_type)((v) >> VALUE_TAG_SHIFT))
+#define IS_NUM(v) (VALUE_TYPE(v) == VAL_NUM)
+#define IS_STRING(v) (VALUE_TYPE(v) == VAL_STRING)
+#define IS_FIXED(v) (VALUE_TYPE(v) == VAL_FIXED)
+#define IS_NUMERIC(v) (IS_NUM(v) || IS_FIXED(v))
+#define IS_TABLE(v) (VALUE_TYPE(v) == VAL_TABLE)
+
+#define AS_NUM(v) ((int32_t)(uint32_t)(v))
+#define AS_STRING(v) ((basic_string *)(uintptr_t)((v) & VALUE_PAYLOAD_MASK))
+#define AS_FIXED(v) ((int32_t)(uint32_t)(v))
+#define AS_TABLE(v) ((basic_table *)(uintptr_t)((v) & VALUE_PAYLOAD_MASK))
+
+#define NUM_VAL(n) (((uint64_t)VAL_NUM << VALUE_TAG_SHIFT) | (uint32_t)(n))
+#define STRING_VAL(s) (((uint64_t)VAL_STRING << VALUE_TAG_SHIFT) | ((uintptr_t)(s) & VALUE_PAYLOAD_MASK))
+#define FIXED_VAL(f) (((uint64_t)VAL_FIXED << VALUE_TAG_SHIFT) | (uint32_t)(f))
+#define TABLE_VAL(t) (((uint64_t)VAL_TABLE << VALUE_TAG_SHIFT) | ((uintptr_t)(t) & VALUE_PAYLOAD_MASK))
+
+// Fixed point numbers are Q16.16
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+// Natives receive their arguments as a slice of the operand stack and return
+// their result, it replaces the arguments in place. argv is only valid until the
+// native returns.
+typedef value (*basic_native)(basic_ctx *ctx, int argc, const value *argv);
+
+// Value returned by natives declared without a result, it is dropped by the caller
+#define BASIC_VOID NUM_VAL(0)
+
+typedef struct {
+    size_t minor_collections;
+    size_t major_collections;
+    size_t objects_freed;
+    size_t bytes_freed;
+    uint64_t last_pause_ns;
+    uint64_t max_pause_ns;
+    uint64_t total_pause_ns;
+} basic_gc_stats;
+
+basic_ctx *interpreter_init(void (*print_fn)(basic_ctx *ctx, const char *text),
+                            void (*append_fn)(basic_ctx *ctx, const char *text), void *user_data);
+// Going past the limit is a runtime error, the default is ARENA_DEFAULT_LIMIT
+void basic_set_memory_limit(basic_ctx *ctx, size_t bytes);
+bool interpreter_load(basic_ctx *ctx, const char *src);
+void advance_interpreter_time(basic_ctx *ctx, float time);
+bool step_program(basic_ctx *ctx);
+// Runs at most max_steps instructions, steps_run if not NULL gets how many were run
+bool interpreter_run(basic_ctx *ctx, size_t max_steps, size_t *steps_run);
+// A suspended program does nothing until it is resumed, interpreter_run returns right away
+bool interpreter_suspended(basic_ctx *ctx);
+void interpreter_destroy(basic_ctx *ctx);
+
+// The signature lists one character per argument: 'i' integer, 'f' fixed point,
+// 'n' any number, 's' string, 't' table and 'v' any value. A trailing '*' makes
+// the last argument repeat any number of times. The result type, if the native
+// returns one, comes after a ':'. "tvi:t" takes a table, any value and an integer
+// and returns a table. Calls are checked against it when the program is compiled.
+void register_function(basic_ctx *ctx, const char *name, basic_native f, const char *signature);
+void register_variable_int(basic_ctx *ctx, const char *name, int value);
+void register_variable_string(basic_ctx *ctx, const char *name, const char *value);
+// Pointer given to interpreter_init, lets natives and print callbacks find their host
+void *basic_user_data(basic_ctx *ctx);
+
+value basic_string_value(basic_ctx *ctx, const char *s);
+const char *basic_value_cstr(basic_ctx *ctx, value v);
+// Natives suspend the program with these, it stops once the native returns.
+// A sleeping program wakes up when advance_interpreter_time gets past the delay.
+// A waiting program is resumed by the host with basic_resume, the value given
+// to it replaces the result of the native that started the wait.
+void basic_sleep(basic_ctx *ctx, float seconds);
+void basic_wait(basic_ctx *ctx);
+void basic_resume(basic_ctx *ctx, value result);
+void basic_error(basic_ctx *ctx, const char *msg);
+basic_gc_stats basic_get_gc_stats(basic_ctx *ctx);
+// Runtime heap of the program, the one the memory limit applies to
+arena_stats basic_get_memory_stats(basic_ctx *ctx);
 
 #endif
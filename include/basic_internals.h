@@ -1,8 +1,10 @@
 #ifndef BASIC_INTERNALS_H
 #define BASIC_INTERNALS_H
 
+#include <setjmp.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "arena.h"
 
 #define TOKENS    \
     X(SEMICOLON)  \
@@ -10,12 +12,17 @@
     X(KEYWORD)    \
     X(STRING)     \
     X(NUMBER)     \
+    X(FIXED)      \
     X(PLUS)       \
     X(MINUS)      \
     X(STAR)       \
     X(SLASH)      \
     X(LPAREN)     \
     X(RPAREN)     \
+    X(LBRACKET)   \
+    X(RBRACKET)   \
+    X(LBRACE)     \
+    X(RBRACE)     \
     X(EQUAL)      \
     X(EQEQ)       \
     X(NEQ)        \
@@ -74,8 +81,7 @@ typedef enum {
     SYMBOL_NONE,
     SYMBOL_FUNCTION,
     SYMBOL_FUNCTION_NATIVE,
-    SYMBOL_VARIABLE_INT,
-    SYMBOL_VARIABLE_STRING,
+    SYMBOL_VARIABLE,
 } symbol_type;
 
 typedef enum {
@@ -83,48 +89,162 @@ typedef enum {
     SCOPE_LOCAL,
 } symbol_scope;
 
+typedef enum {
+    GC_STRING,
+    GC_STRING_BUFFER,
+    GC_TABLE,
+    GC_KIND_COUNT,
+} gc_kind;
+
+// Header of every object the collector manages, it must be the first member
+typedef struct gc_object {
+    struct gc_object *next;
+    gc_kind kind;
+    bool marked;
+    // Survived a collection, minor collections don't trace through old objects
+    bool old;
+    // Old object that was written to since the last collection
+    bool remembered;
+} gc_object;
+
+typedef struct {
+    // New objects go to the nursery and are promoted after surviving one collection
+    gc_object *young;
+    gc_object *old;
+    // Objects of a kind all have the same size, dead ones are reused instead of
+    // going back to the arena where they would fragment the free list
+    gc_object *free[GC_KIND_COUNT];
+
+    struct {
+        gc_object **items;
+        size_t count;
+        size_t capacity;
+    } remembered;
+
+    // Young values stored in old objects that are too big to trace at every
+    // minor collection, the first store of a value in a big table for instance
+    struct {
+        value *items;
+        size_t count;
+        size_t capacity;
+    } remembered_values;
+
+    struct {
+        gc_object **items;
+        size_t count;
+        size_t capacity;
+    } gray;
+
+    // Weak set of interned strings, open addressing with NULL for empty slots
+    struct {
+        struct basic_string **items;
+        size_t count;
+        size_t capacity;
+    } interned;
+
+    // Arena usage at which the next minor and major collections happen
+    size_t next_minor;
+    size_t next_major;
+    bool major_requested;
+
+    basic_gc_stats stats;
+} gc_heap;
+
+// Collections only run between two steps, natives can hold raw pointers until they return
+#define GC_NURSERY_BYTES (256 * 1024)
+#define GC_MIN_MAJOR_BYTES (1024 * 1024)
+
+typedef struct {
+    gc_object gc;
+    char *chars;
+    size_t length;
+    // 0 when chars is borrowed and can't be appended to in place
+    size_t capacity;
+} string_buffer;
+
+// A string is a range of a buffer shared with the strings it was built from
+// or sliced from. Appending to the string that ends its buffer writes in place,
+// the other strings keep seeing their own range so values stay immutable.
+typedef struct basic_string {
+    gc_object gc;
+    string_buffer *buffer;
+    size_t offset;
+    size_t length;
+    // Computed on first use, 0 means not computed yet
+    uint64_t hash;
+    bool interned;
+} basic_string;
+
+// Strings up to this length are interned, two of them are equal only if they are the same object
+#define STRING_INTERN_MAX_LENGTH 32
+
+#define string_chars(s) ((s)->buffer->chars + (s)->offset)
+
+// No valid value has this tag, marks unused slots in the table hash part
+#define TABLE_EMPTY_KEY UINT64_MAX
+
+typedef struct {
+    value key;
+    value value;
+} table_entry;
+
+// Tables have a dense array part for the integer keys 0..count-1 and an open
+// addressing hash part (linear probing) for everything else.
+typedef struct {
+    gc_object gc;
+    struct {
+        value *items;
+        size_t count;
+        size_t capacity;
+    } array;
+
+    table_entry *entries;
+    size_t hash_count;
+    size_t hash_capacity;
+} basic_table;
+
+#define NATIVE_MAX_ARGS 8
+
+typedef struct {
+    const char *name;
+    basic_native function;
+    // Bit (1 << value_type) is set for every type the argument accepts
+    uint8_t arg_types[NATIVE_MAX_ARGS];
+    uint8_t arg_count;
+    // The last argument repeats, arg_count is then the minimum
+    bool variadic;
+    bool returns;
+} native_function;
+
 typedef struct {
     const char *name;
-    symbol_type type;
-    size_t depth;
     union {
-        struct {
-            void (*function)();
-            bool variadic_arg_count;
-            size_t arg_count;
-        } native_func;
-        int integer;
-        const char *string;
-        struct {
-            function_code *body;
-            const char **args;
-            size_t arg_count;
-        } funcdecl;
+        // Index in the interpreter natives
+        size_t native;
+        value value;
+        function_code *funcdecl;
     } as;
+    uint32_t depth;
+    symbol_type type;
 } symbol;
 
 typedef enum {
     STATE_RUNNING,
     STATE_FINISHED,
+    // Parked until time_elapsed reaches wakeup_time
     STATE_SLEEPING,
+    // Parked until the host calls basic_resume
+    STATE_WAITING,
 } interpreter_state;
 
 #define MAX_SYMBOL_COUNT 2048
 
-typedef enum { VAL_NUM, VAL_STRING } value_type;
-
-typedef struct {
-    value_type type;
-    union {
-        int16_t number;
-        const char *string;
-    } as;
-} value;
-
 typedef enum {
     OPCODE_VARIABLE,
     OPCODE_CONSTANT_STRING,
     OPCODE_CONSTANT_NUMBER,
+    OPCODE_CONSTANT_NUMBER_WIDE,
+    OPCODE_CONSTANT_FIXED,
     OPCODE_EQEQ,
     OPCODE_NEQ,
     OPCODE_LT,
@@ -137,7 +257,12 @@ typedef enum {
     OPCODE_DIV,
     OPCODE_NEGATE,
     OPCODE_ASSIGN,
+    OPCODE_TABLE_NEW,
+    OPCODE_INDEX_LOAD,
+    OPCODE_INDEX_STORE,
+    OPCODE_TABLE_NEXT,
     OPCODE_FUNCALL,
+    OPCODE_CALL_NATIVE,
     OPCODE_JUMP_IF_FALSE,
     OPCODE_JUMP,
     OPCODE_RETURN,
@@ -152,9 +277,37 @@ typedef struct {
     size_t symbols_count;
 } return_frame;
 
+// Allocations are split by lifetime so the churn of the running program does
+// not fragment the memory holding its code.
 struct basic_interpreter {
-    void (*print_fn)(const char *text);
-    void (*append_print_fn)(const char *text);
+    // Runtime heap, GC objects and their contents and the stacks
+    arena *arena;
+    // Bytecode, constants, natives and names, they live as long as the context
+    arena *code_arena;
+    // Tokens, freed as soon as the program is compiled
+    arena *compile_arena;
+    // Temporaries of a single opcode, the opcode using it clears it first
+    arena *scratch;
+    void *user_data;
+    void (*print_fn)(basic_ctx *ctx, const char *text);
+    void (*append_print_fn)(basic_ctx *ctx, const char *text);
+
+    // Runtime and compile errors longjmp back to the entry point that is running
+    jmp_buf err_jmp;
+    int error_line;
+
+    // Compile time state, the tokens are freed once the program is compiled
+    struct {
+        struct {
+            token *items;
+            size_t count;
+            size_t capacity;
+        } tokens;
+        size_t reader;
+        bool inside_function_declaration;
+        const char *last_function;
+        size_t hidden_variable_count;
+    } parser;
 
     symbol symbols_table[MAX_SYMBOL_COUNT];
     size_t symbols_table_count;
@@ -163,6 +316,8 @@ struct basic_interpreter {
     interpreter_state state;
     float time_elapsed;
     float wakeup_time;
+    // The native that started the wait returns a value, basic_resume replaces it
+    bool resume_has_result;
 
     struct {
         function_code *items;
@@ -180,6 +335,12 @@ struct basic_interpreter {
         size_t capacity;
     } values;
 
+    struct {
+        native_function *items;
+        size_t count;
+        size_t capacity;
+    } natives;
+
     struct {
         value *items;
         size_t count;
@@ -191,9 +352,38 @@ struct basic_interpreter {
         size_t count;
         size_t capacity;
     } return_stack;
+
+    gc_heap gc;
 };
 
 symbol *get_symbol_id(size_t idx);
 size_t create_symbol(const char *name, symbol_type type);
+void basic_push_value(value v);
+void basic_push_int(int result);
+int32_t basic_pop_value_num();
+const char *basic_pop_value_string();
+
+void *gc_alloc(gc_kind kind, size_t size);
+void gc_write_barrier(gc_object *object);
+void gc_collect(bool major);
+
+basic_string *string_wrap(const char *chars);
+basic_string *string_append(basic_string *s, const char *chars, size_t length);
+basic_string *string_slice(basic_string *s, size_t offset, size_t length);
+const char *string_cstr(basic_string *s);
+uint64_t string_hash(basic_string *s);
+bool strings_equal(basic_string *a, basic_string *b);
+void string_intern_purge(bool major);
+
+int64_t numeric_as_fixed(value v);
+value fixed_result(int64_t fixed, const char *op);
+value numeric_add(value a, value b);
+value numeric_mul(value a, value b);
+int compare_numbers(value a, value b);
+
+basic_table *table_new(size_t array_capacity);
+bool table_get(basic_table *t, value key, value *result);
+void table_set(basic_table *t, value key, value v);
+void table_array_resize(basic_table *t, size_t count);
 
 #endif
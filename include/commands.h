@@ -4,15 +4,20 @@ const char connect_help[] = "\x23\x20\x43\x6f\x6e\x6e\x65\x63\x74\x0a\x0a\x55\x7
 const char create_help[] = "\x23\x20\x43\x72\x65\x61\x74\x65\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x63\x72\x65\x61\x74\x65\x20\x28\x64\x7c\x66\x29\x20\x3c\x70\x61\x74\x68\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x43\x72\x65\x61\x74\x65\x73\x20\x61\x0a\x64\x69\x72\x65\x63\x74\x6f\x72\x79\x20\x28\x64\x29\x20\x6f\x72\x20\x66\x69\x6c\x65\x20\x28\x66\x29\x0a\x61\x74\x20\x74\x68\x65\x20\x67\x69\x76\x65\x6e\x20\x70\x61\x74\x68\x2e\x0a\x0a\x49\x74\x20\x77\x69\x6c\x6c\x20\x6e\x6f\x74\x20\x63\x72\x65\x61\x74\x65\x20\x0a\x6e\x6f\x6e\x2d\x65\x78\x69\x73\x74\x61\x6e\x74\x20\x73\x75\x62\x20\x70\x61\x74\x68\x2e\x0a";
 const char echo_help[] = "\x23\x20\x45\x63\x68\x6f\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x65\x63\x68\x6f\x20\x28\x2e\x2e\x2e\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x50\x72\x69\x6e\x74\x73\x20\x61\x6c\x6c\x0a\x67\x69\x76\x65\x6e\x20\x61\x72\x67\x75\x6d\x65\x6e\x74\x73\x20\x74\x6f\x20\x74\x68\x65\x0a\x73\x63\x72\x65\x65\x6e\x2e\x0a";
 const char edit_help[] = "\x23\x20\x45\x64\x69\x74\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x65\x64\x69\x74\x20\x3c\x66\x69\x6c\x65\x20\x70\x61\x74\x68\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x4f\x70\x65\x6e\x73\x20\x74\x68\x65\x20\x0a\x67\x69\x76\x65\x6e\x20\x66\x69\x6c\x65\x20\x69\x6e\x20\x74\x68\x65\x20\x65\x64\x69\x74\x6f\x72\x2e\x0a";
-const char exec_help[] = "\x23\x20\x45\x78\x65\x63\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x65\x78\x65\x63\x20\x3c\x66\x69\x6c\x65\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x45\x78\x65\x63\x75\x74\x65\x20\x61\x0a\x70\x72\x6f\x67\x72\x61\x6d\x2e\x0a";
+const char exec_help[] = "\x23\x20\x45\x78\x65\x63\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x65\x78\x65\x63\x20\x28\x2d\x70\x20\x3c\x31\x2d\x39\x3e\x29\x0a\x3c\x66\x69\x6c\x65\x3e\x20\x28\x26\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x45\x78\x65\x63\x75\x74\x65\x20\x61\x0a\x70\x72\x6f\x67\x72\x61\x6d\x2e\x0a\x0a\x45\x6e\x64\x69\x6e\x67\x20\x74\x68\x65\x20\x63\x6f\x6d\x6d\x61\x6e\x64\x20\x77\x69\x74\x68\x0a\x26\x20\x72\x75\x6e\x73\x20\x74\x68\x65\x20\x70\x72\x6f\x67\x72\x61\x6d\x20\x69\x6e\x0a\x74\x68\x65\x20\x62\x61\x63\x6b\x67\x72\x6f\x75\x6e\x64\x2e\x0a\x0a\x50\x72\x6f\x67\x72\x61\x6d\x73\x20\x77\x69\x74\x68\x20\x61\x20\x68\x69\x67\x68\x65\x72\x0a\x70\x72\x69\x6f\x72\x69\x74\x79\x20\x28\x2d\x70\x2c\x20\x64\x65\x66\x61\x75\x6c\x74\x20\x34\x29\x0a\x67\x65\x74\x20\x6d\x6f\x72\x65\x20\x74\x69\x6d\x65\x2e\x0a";
+const char fg_help[] = "\x23\x20\x46\x67\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x66\x67\x20\x28\x69\x64\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x42\x72\x69\x6e\x67\x73\x20\x61\x0a\x62\x61\x63\x6b\x67\x72\x6f\x75\x6e\x64\x20\x70\x72\x6f\x67\x72\x61\x6d\x20\x74\x6f\x0a\x74\x68\x65\x20\x66\x6f\x72\x65\x67\x72\x6f\x75\x6e\x64\x2e\x0a\x0a\x49\x66\x20\x6e\x6f\x20\x69\x64\x20\x69\x73\x20\x67\x69\x76\x65\x6e\x20\x74\x68\x65\x0a\x6d\x6f\x73\x74\x20\x72\x65\x63\x65\x6e\x74\x20\x62\x61\x63\x6b\x67\x72\x6f\x75\x6e\x64\x0a\x70\x72\x6f\x67\x72\x61\x6d\x20\x69\x73\x20\x75\x73\x65\x64\x2e\x0a";
 const char help_help[] = "\x23\x20\x48\x65\x6c\x70\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x68\x65\x6c\x70\x20\x28\x63\x6f\x6d\x6d\x61\x6e\x64\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x44\x65\x73\x63\x72\x69\x62\x65\x0a\x61\x6c\x6c\x20\x63\x6f\x6d\x6d\x61\x6e\x64\x73\x20\x69\x6e\x73\x74\x61\x6c\x6c\x65\x64\x20\x6f\x6e\x0a\x74\x68\x65\x20\x73\x79\x73\x74\x65\x6d\x2e\x0a\x0a\x47\x69\x76\x69\x6e\x67\x20\x61\x20\x63\x6f\x6d\x6d\x61\x6e\x64\x20\x6e\x61\x6d\x65\x0a\x77\x69\x6c\x6c\x20\x6f\x70\x65\x6e\x20\x74\x68\x65\x20\x63\x6f\x6d\x6d\x61\x6e\x64\x0a\x68\x65\x6c\x70\x20\x70\x61\x67\x65\x20\x64\x69\x72\x65\x63\x74\x6c\x79\x2e\x0a";
 const char hostname_help[] = "\x23\x20\x48\x6f\x73\x74\x6e\x61\x6d\x65\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x68\x6f\x73\x74\x6e\x61\x6d\x65\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x50\x72\x69\x6e\x74\x73\x20\x74\x68\x65\x0a\x63\x75\x72\x72\x65\x6e\x74\x20\x6d\x61\x63\x68\x69\x6e\x65\x20\x68\x6f\x73\x74\x6e\x61\x6d\x65\x2e\x0a";
+const char kill_help[] = "\x23\x20\x4b\x69\x6c\x6c\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x6b\x69\x6c\x6c\x20\x3c\x69\x64\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x53\x74\x6f\x70\x73\x20\x74\x68\x65\x0a\x70\x72\x6f\x67\x72\x61\x6d\x20\x77\x69\x74\x68\x20\x74\x68\x65\x20\x67\x69\x76\x65\x6e\x0a\x6a\x6f\x62\x20\x69\x64\x2e\x0a";
 const char list_help[] = "\x23\x20\x4c\x69\x73\x74\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x6c\x69\x73\x74\x20\x28\x70\x61\x74\x68\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x4c\x69\x73\x74\x0a\x64\x69\x72\x65\x63\x74\x6f\x72\x79\x20\x63\x6f\x6e\x74\x65\x6e\x74\x20\x61\x74\x20\x74\x68\x65\x0a\x67\x69\x76\x65\x6e\x20\x70\x61\x74\x68\x2e\x0a\x0a\x49\x66\x20\x6e\x6f\x20\x70\x61\x74\x68\x20\x69\x73\x20\x70\x72\x65\x73\x65\x6e\x74\x2c\x0a\x74\x68\x65\x20\x63\x75\x72\x72\x65\x6e\x74\x20\x77\x6f\x72\x6b\x69\x6e\x67\x0a\x64\x69\x72\x65\x63\x74\x6f\x72\x79\x20\x69\x73\x20\x69\x6d\x70\x6c\x69\x65\x64\x2e\x0a";
 const char machines_help[] = "";
 const char mail_help[] = "\x23\x20\x4d\x61\x69\x6c\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x6d\x61\x69\x6c\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x4f\x70\x65\x6e\x73\x20\x74\x68\x65\x0a\x6d\x61\x69\x6c\x20\x61\x70\x70\x6c\x69\x63\x61\x74\x69\x6f\x6e\x2e\x0a";
+const char mem_help[] = "\x23\x20\x4d\x65\x6d\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x6d\x65\x6d\x20\x28\x69\x64\x29\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x53\x68\x6f\x77\x73\x20\x74\x68\x65\x0a\x6d\x65\x6d\x6f\x72\x79\x20\x75\x73\x65\x64\x20\x62\x79\x20\x74\x68\x65\x0a\x70\x72\x6f\x67\x72\x61\x6d\x73\x20\x72\x75\x6e\x6e\x69\x6e\x67\x20\x6f\x6e\x20\x74\x68\x65\x0a\x6d\x61\x63\x68\x69\x6e\x65\x2e\x0a\x0a\x47\x69\x76\x69\x6e\x67\x20\x61\x20\x6a\x6f\x62\x20\x69\x64\x20\x73\x68\x6f\x77\x73\x0a\x74\x68\x65\x20\x64\x65\x74\x61\x69\x6c\x73\x20\x6f\x66\x20\x6f\x6e\x65\x0a\x70\x72\x6f\x67\x72\x61\x6d\x2c\x20\x77\x69\x74\x68\x20\x69\x74\x73\x0a\x61\x6c\x6c\x6f\x63\x61\x74\x69\x6f\x6e\x73\x20\x62\x79\x20\x73\x69\x7a\x65\x2e\x0a";
 const char netscan_help[] = "\x23\x20\x4e\x65\x74\x73\x63\x61\x6e\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x6e\x65\x74\x73\x63\x61\x6e\x20\x3c\x69\x70\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x53\x63\x61\x6e\x73\x20\x74\x68\x65\x0a\x6e\x65\x74\x77\x6f\x72\x6b\x20\x73\x70\x65\x63\x69\x66\x69\x65\x64\x20\x62\x79\x20\x74\x68\x65\x0a\x67\x69\x76\x65\x6e\x20\x49\x50\x2e\x0a\x0a\x57\x69\x6c\x6c\x20\x64\x69\x73\x70\x6c\x61\x79\x20\x72\x65\x61\x63\x68\x61\x62\x6c\x65\x0a\x6d\x61\x63\x68\x69\x6e\x65\x73\x20\x69\x6e\x20\x74\x68\x65\x20\x6e\x65\x74\x77\x6f\x72\x6b\x2e\x0a";
 const char path_help[] = "\x23\x20\x50\x61\x74\x68\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x70\x61\x74\x68\x20\x3c\x70\x61\x74\x68\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x50\x72\x69\x6e\x74\x73\x0a\x67\x69\x76\x65\x6e\x20\x70\x61\x74\x68\x20\x66\x75\x6c\x6c\x20\x70\x61\x74\x68\x2e\x0a";
 const char ping_help[] = "\x23\x20\x50\x69\x6e\x67\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x70\x69\x6e\x67\x20\x3c\x69\x70\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x43\x68\x65\x63\x6b\x20\x69\x66\x20\x74\x68\x65\x0a\x67\x69\x76\x65\x6e\x20\x49\x50\x20\x61\x64\x64\x72\x65\x73\x73\x20\x69\x73\x0a\x72\x65\x61\x63\x68\x61\x62\x6c\x65\x2e\x0a";
 const char print_help[] = "\x23\x20\x50\x72\x69\x6e\x74\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x70\x72\x69\x6e\x74\x20\x3c\x66\x69\x6c\x65\x3e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x50\x72\x69\x6e\x74\x73\x0a\x66\x69\x6c\x65\x27\x73\x20\x63\x6f\x6e\x74\x65\x6e\x74\x20\x74\x6f\x20\x74\x68\x65\x20\x0a\x73\x63\x72\x65\x65\x6e\x2e\x0a";
+const char ps_help[] = "\x23\x20\x50\x73\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x70\x73\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x4c\x69\x73\x74\x73\x20\x74\x68\x65\x0a\x70\x72\x6f\x67\x72\x61\x6d\x73\x20\x72\x75\x6e\x6e\x69\x6e\x67\x20\x6f\x6e\x20\x74\x68\x65\x0a\x6d\x61\x63\x68\x69\x6e\x65\x2e\x0a";
 const char pwd_help[] = "\x23\x20\x50\x72\x69\x6e\x74\x20\x77\x6f\x72\x6b\x69\x6e\x67\x20\x64\x69\x72\x65\x63\x74\x6f\x72\x79\x20\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x70\x77\x64\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x50\x72\x69\x6e\x74\x73\x0a\x74\x68\x65\x20\x63\x75\x72\x72\x65\x6e\x74\x20\x77\x6f\x72\x6b\x69\x6e\x67\x0a\x64\x69\x72\x65\x63\x74\x6f\x72\x79\x2e\x0a";
+const char reboot_help[] = "\x23\x20\x52\x65\x62\x6f\x6f\x74\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x72\x65\x62\x6f\x6f\x74\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x52\x65\x73\x74\x61\x72\x74\x73\x20\x74\x68\x65\x0a\x6d\x61\x63\x68\x69\x6e\x65\x2c\x20\x69\x74\x73\x20\x66\x69\x6c\x65\x73\x20\x61\x6e\x64\x0a\x69\x74\x73\x20\x68\x69\x73\x74\x6f\x72\x79\x20\x61\x72\x65\x20\x62\x61\x63\x6b\x20\x61\x73\x0a\x74\x68\x65\x79\x20\x77\x65\x72\x65\x20\x61\x74\x20\x73\x74\x61\x72\x74\x75\x70\x2e\x0a\x0a\x52\x75\x6e\x6e\x69\x6e\x67\x20\x70\x72\x6f\x67\x72\x61\x6d\x73\x20\x6d\x75\x73\x74\x0a\x62\x65\x20\x73\x74\x6f\x70\x70\x65\x64\x20\x66\x69\x72\x73\x74\x2e\x0a";
 const char shutdown_help[] = "\x23\x20\x53\x68\x75\x74\x64\x6f\x77\x6e\x0a\x0a\x55\x73\x61\x67\x65\x3a\x20\x73\x68\x75\x74\x64\x6f\x77\x6e\x0a\x0a\x44\x65\x73\x63\x72\x69\x70\x74\x69\x6f\x6e\x3a\x20\x53\x68\x75\x74\x64\x6f\x77\x6e\x73\x0a\x74\x68\x65\x20\x6d\x61\x63\x68\x69\x6e\x65\x2e\x0a";
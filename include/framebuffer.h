@@ -0,0 +1,19 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "raylib.h"
+
+// Pixels drawn by programs, one byte per pixel holding the index of its color in
+// the palette. Uploaded as it is and colored by the shader.
+#define FB_SIZE_WIDTH 80
+#define FB_SIZE_HEIGHT 60
+#define FB_SIZE (FB_SIZE_WIDTH * FB_SIZE_HEIGHT)
+
+// Needs the window, the palette is given to the shader once
+void framebuffer_renderer_init(const Color *palette, int palette_count);
+// Texture of FB_SIZE_WIDTH by FB_SIZE_HEIGHT indices, fill it with UpdateTexture
+Texture2D framebuffer_texture_load();
+// A single quad scaled over dest
+void framebuffer_draw(Texture2D texture, Rectangle dest);
+
+#endif
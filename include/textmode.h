@@ -0,0 +1,40 @@
+#ifndef TEXTMODE_H
+#define TEXTMODE_H
+
+#include "raylib.h"
+
+// Screen of character cells, everything the terminal shows with its font goes
+// through it and the whole screen is drawn at once.
+#define TEXT_SCREEN_COLUMNS 42
+#define TEXT_SCREEN_ROWS 23
+
+// Low bits of an attribute are the index of the color in the palette
+#define TEXT_COLOR_MASK 0x0F
+// The cell is filled with the color and the glyph is cut out of it
+#define TEXT_INVERSE 0x10
+// Thin cursor bar over the cell
+#define TEXT_CURSOR 0x20
+
+// Same layout as a gray and alpha texel, the cells are uploaded as they are
+typedef struct {
+    unsigned char glyph;
+    unsigned char attr;
+} text_cell;
+
+typedef struct {
+    text_cell cells[TEXT_SCREEN_ROWS][TEXT_SCREEN_COLUMNS];
+} text_screen;
+
+void text_screen_clear(text_screen *s);
+// Cut at the end of the row, returns the column after the text
+int text_screen_print(text_screen *s, int column, int row, const char *text, unsigned char attr);
+// Changes the attribute of count cells and keeps their glyphs
+void text_screen_fill_attr(text_screen *s, int column, int row, int count, unsigned char attr);
+
+// Needs the window, the printable glyphs of the font are drawn once in an atlas
+void text_renderer_init(Font font, int font_size, const Color *palette, int palette_count);
+Vector2 text_renderer_cell_size();
+// A single draw call however many cells hold text
+void text_screen_draw(const text_screen *s, Vector2 position);
+
+#endif
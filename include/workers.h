@@ -0,0 +1,44 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Three buffers shared by a producer and a consumer. The producer draws in back
+// and swaps it with the published slot, the consumer swaps front with the
+// published slot when it holds a newer frame. Neither side ever waits.
+typedef struct {
+    // Index of the published buffer, TRIPLE_BUFFER_FRESH is set until it is taken
+    _Atomic int published;
+    int back;
+    int front;
+} triple_buffer;
+
+#define TRIPLE_BUFFER_FRESH 4
+
+void triple_buffer_init(triple_buffer *b);
+void triple_buffer_publish(triple_buffer *b);
+bool triple_buffer_acquire(triple_buffer *b);
+
+typedef enum {
+    JOB_CONTINUE,
+    // Nothing to do until someone calls worker_job_wake, the job costs nothing meanwhile
+    JOB_PARK,
+    JOB_DONE,
+} job_status;
+
+// Runs a bounded slice of work, a job is only ever stepped by one worker at a time
+typedef job_status (*job_step)(void *data);
+
+typedef struct worker_job worker_job;
+
+void workers_init();
+size_t workers_count();
+worker_job *workers_submit(job_step step, void *data);
+bool worker_job_done(worker_job *job);
+// No worker touches the data of a parked job, whoever wakes it can use it until then
+bool worker_job_parked(worker_job *job);
+void worker_job_wake(worker_job *job);
+void worker_job_free(worker_job *job);
+
+#endif
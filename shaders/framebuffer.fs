@@ -0,0 +1,20 @@
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// One texel per pixel of the program, the index of its color in red
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+
+out vec4 finalColor;
+
+uniform vec4 palette[16];
+
+void main()
+{
+    ivec2 size = textureSize(texture0, 0);
+    ivec2 pixel = min(ivec2(fragTexCoord * vec2(size)), size - 1);
+    int index = int(texelFetch(texture0, pixel, 0).r * 255.0 + 0.5);
+    finalColor = palette[index & 15];
+}
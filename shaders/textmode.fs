@@ -0,0 +1,49 @@
+#version 330
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+// One texel per cell, the glyph in red and the attribute in alpha
+uniform sampler2D texture0;
+uniform sampler2D atlas;
+uniform vec4 colDiffuse;
+
+out vec4 finalColor;
+
+uniform vec2 gridSize;
+uniform vec2 cellSize;
+uniform vec4 palette[16];
+
+const vec2 atlasSize = vec2(16.0, 8.0);
+const int attrColor = 15;
+const int attrInverse = 16;
+const int attrCursor = 32;
+
+void main()
+{
+    vec2 position = fragTexCoord * gridSize;
+    ivec2 cell = min(ivec2(position), ivec2(gridSize) - 1);
+    vec2 inside = fract(position);
+
+    vec4 texel = texelFetch(texture0, cell, 0);
+    int glyph = int(texel.r * 255.0 + 0.5);
+    int attr = int(texel.a * 255.0 + 0.5);
+
+    vec2 glyphCell = vec2(glyph % 16, glyph / 16);
+    // Glyphs were drawn in white over a transparent atlas, red is their coverage
+    float coverage = texture(atlas, (glyphCell + inside) / atlasSize).r;
+
+    if ((attr & attrCursor) != 0) {
+        vec2 pixel = inside * cellSize;
+        if (pixel.x >= 8.0 && pixel.x < 18.0 && pixel.y >= 4.0 && pixel.y < cellSize.y - 4.0) {
+            coverage = 1.0;
+        }
+    }
+
+    vec3 color = palette[attr & attrColor].rgb;
+    if ((attr & attrInverse) != 0) {
+        finalColor = vec4(color * (1.0 - coverage), 1.0);
+    } else {
+        finalColor = vec4(color, coverage);
+    }
+}
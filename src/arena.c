@@ -3,120 +3,229 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
+#define ARENA_IN_USE ((size_t)1)
+
+static_assert(sizeof(arena_block_header) % ARENA_ALIGNMENT == 0);
+static_assert(alignof(max_align_t) <= ARENA_ALIGNMENT);
+
+static size_t align_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+void arena_clear(arena *a) {
+    a->used = 0;
+    a->top = (arena_block_header *)a->content;
+    a->top->size = a->size;
+    a->top->prev_size = 0;
+    memset(a->free_lists, 0, sizeof(a->free_lists));
+    a->free_classes = 0;
+}
+
+// Pages are only backed by memory once committed and touched, an idle
+// interpreter costs one chunk
 arena *arena_default() {
     arena *a = malloc(sizeof(*a));
     assert(a);
-    a->size = ARENA_DEFAULT_SIZE;
-    a->content = malloc(a->size);
-    a->head = (arena_block *)a->content;
-    a->head->block_size = a->size;
-    a->head->next = NULL;
-    a->used = 0;
-    assert(a->content);
+    a->reserved = ARENA_RESERVE_SIZE;
+    a->content = mmap(NULL, a->reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(a->content != MAP_FAILED);
+    a->size = ARENA_CHUNK_SIZE;
+    int result = mprotect(a->content, a->size, PROT_READ | PROT_WRITE);
+    assert(result == 0);
+    a->limit = ARENA_DEFAULT_LIMIT;
+    a->on_exhausted = NULL;
+#ifdef ARENA_STATS
+    memset(&a->counters, 0, sizeof(a->counters));
+#endif
+    arena_clear(a);
     return a;
 }
 
-static void arena_remove_node(arena_block **head, arena_block *prev, arena_block *del) {
-    if (prev == NULL) {
-        *head = del->next;
-    } else {
-        prev->next = del->next;
+void arena_set_limit(arena *a, size_t limit) {
+    limit = align_up(limit, ARENA_CHUNK_SIZE);
+    if (limit > a->reserved) {
+        limit = a->reserved;
     }
+    a->limit = limit < a->size ? a->size : limit;
 }
 
-static size_t align_up(size_t n, size_t align) {
-    return (n + align - 1) & ~(align - 1);
+// Only the first chunk stays committed, the arena grows again from there
+void arena_reset(arena *a) {
+    madvise(a->content, a->size, MADV_DONTNEED);
+    if (a->size > ARENA_CHUNK_SIZE) {
+        int result = mprotect(a->content + ARENA_CHUNK_SIZE, a->size - ARENA_CHUNK_SIZE, PROT_NONE);
+        assert(result == 0);
+        a->size = ARENA_CHUNK_SIZE;
+    }
+    arena_clear(a);
+}
+
+// Commits enough chunks for the top to hold size bytes
+static bool arena_commit(arena *a, size_t size) {
+    size_t needed = (char *)a->top + size - (a->content + a->size);
+    if (a->size + needed > a->limit) {
+        return false;
+    }
+    size_t grow = align_up(needed, ARENA_CHUNK_SIZE);
+    if (a->size + grow > a->limit) {
+        grow = a->limit - a->size;
+    }
+    if (mprotect(a->content + a->size, grow, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    a->size += grow;
+    a->top->size += grow;
+    return true;
 }
 
-static inline int are_adjacent(arena_block *a, arena_block *b) {
-    return (char *)a + a->block_size == (char *)b;
+static size_t block_size(const arena_block_header *header) {
+    return header->size & ~ARENA_IN_USE;
 }
 
-static void arena_insert_sorted(arena_block **head, arena_block *block) {
-    arena_block *node = *head;
-    arena_block *prev = NULL;
+static arena_block_header *block_next(arena_block_header *header) {
+    return (arena_block_header *)((char *)header + block_size(header));
+}
 
-    while (node && node < block) {
-        prev = node;
-        node = node->next;
+static size_t size_class(size_t size) {
+    if (size < ARENA_SMALL_LIMIT) {
+        return size / ARENA_ALIGNMENT;
     }
+    size_t log2 = 63 - __builtin_clzll(size);
+    size_t class = ARENA_SMALL_CLASSES + log2 - __builtin_ctzll(ARENA_SMALL_LIMIT);
+    return class < ARENA_CLASS_COUNT ? class : ARENA_CLASS_COUNT - 1;
+}
 
-    block->next = node;
+#ifdef ARENA_STATS
+static void count_alloc(arena *a, size_t size) {
+    size_t class = size_class(size);
+    a->counters.allocs++;
+    a->counters.class_allocs[class]++;
+    a->counters.class_bytes[class] += size;
+}
 
-    if (prev) {
-        prev->next = block;
-    } else {
-        *head = block;
+static void count_free(arena *a) {
+    a->counters.frees++;
+}
+
+static void count_used(arena *a) {
+    if (a->used > a->counters.peak) {
+        a->counters.peak = a->used;
+    }
+}
+#else
+#define count_alloc(a, size) ((void)0)
+#define count_free(a) ((void)0)
+#define count_used(a) ((void)0)
+#endif
+
+static void free_list_push(arena *a, arena_block *block) {
+    size_t class = size_class(block->header.size);
+    block->prev = NULL;
+    block->next = a->free_lists[class];
+    if (block->next != NULL) {
+        block->next->prev = block;
     }
+    a->free_lists[class] = block;
+    a->free_classes |= (uint64_t)1 << class;
 }
 
-static void arena_coalesce(arena_block **head, arena_block *block) {
-    arena_block *node = *head;
-    arena_block *prev = NULL;
+static void free_list_remove(arena *a, arena_block *block) {
+    size_t class = size_class(block->header.size);
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        a->free_lists[class] = block->next;
+        if (block->next == NULL) {
+            a->free_classes &= ~((uint64_t)1 << class);
+        }
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+}
 
-    while (node && node != block) {
-        prev = node;
-        node = node->next;
+// Marks the block as used with the given size, what is left becomes a free block
+static void block_split(arena *a, arena_block_header *header, size_t size) {
+    size_t total = block_size(header);
+    if (total - size < sizeof(arena_block)) {
+        // Too small to be a free block, it stays with the allocation
+        header->size = total | ARENA_IN_USE;
+        return;
     }
+    header->size = size | ARENA_IN_USE;
+    arena_block *rest = (arena_block *)((char *)header + size);
+    rest->header.size = total - size;
+    rest->header.prev_size = size;
+    // The neighbour after a free block is always in use or the top
+    block_next(&rest->header)->prev_size = rest->header.size;
+    free_list_push(a, rest);
+}
 
-    if (block->next && are_adjacent(block, block->next)) {
-        block->block_size += block->next->block_size;
-        block->next = block->next->next;
+static arena_block_header *arena_find_free(arena *a, size_t size) {
+    size_t class = size_class(size);
+    if (class >= ARENA_SMALL_CLASSES) {
+        // Large classes hold a range of sizes, the blocks of the exact class may be too small
+        for (arena_block *block = a->free_lists[class]; block != NULL; block = block->next) {
+            if (block->header.size >= size) {
+                free_list_remove(a, block);
+                return &block->header;
+            }
+        }
+    } else if (a->free_lists[class] != NULL) {
+        arena_block *block = a->free_lists[class];
+        free_list_remove(a, block);
+        return &block->header;
     }
 
-    if (prev && are_adjacent(prev, block)) {
-        prev->block_size += block->block_size;
-        prev->next = block->next;
+    // Any block of a bigger class fits
+    uint64_t bigger = class + 1 < ARENA_CLASS_COUNT ? a->free_classes >> (class + 1) << (class + 1) : 0;
+    if (bigger == 0) {
+        return NULL;
     }
+    arena_block *block = a->free_lists[__builtin_ctzll(bigger)];
+    free_list_remove(a, block);
+    return &block->header;
 }
 
-static arena_block *arena_next_block(arena *a, arena_block *block) {
-    char *end = (char *)block + block->block_size;
-    char *arena_end = (char *)a->content + a->size;
-
-    if (end >= arena_end)
+// Takes fresh space at the top, the top keeps room for its own header
+static arena_block_header *arena_bump(arena *a, size_t size) {
+    if (a->top->size < size + sizeof(arena_block_header) && !arena_commit(a, size + sizeof(arena_block_header))) {
         return NULL;
+    }
+    arena_block_header *header = a->top;
+    size_t remaining = header->size - size;
+    a->top = (arena_block_header *)((char *)header + size);
+    a->top->size = remaining;
+    a->top->prev_size = size;
+    header->size = size;
+    return header;
+}
 
-    return (arena_block *)end;
+// Size of the block holding an allocation of the given size
+static size_t block_size_for(size_t size) {
+    size = align_up(size, ARENA_ALIGNMENT) + sizeof(arena_block_header);
+    return size < sizeof(arena_block) ? sizeof(arena_block) : size;
 }
 
 void *arena_alloc(arena *a, size_t size) {
-    const size_t alignment = alignof(max_align_t);
-
-    size = align_up(size, alignment);
-    size_t required = size + sizeof(arena_block_header);
+    size = block_size_for(size);
 
-    arena_block *node = a->head;
-    arena_block *prev_node = NULL;
-
-    while (node != NULL) {
-        if (node->block_size >= required) {
-            break;
-        }
-        prev_node = node;
-        node = node->next;
+    arena_block_header *header = arena_find_free(a, size);
+    if (header == NULL) {
+        header = arena_bump(a, size);
     }
-
-    if (node == NULL) {
-        assert(0 && "Failed to allocate memory.");
+    if (header == NULL) {
+        if (a->on_exhausted != NULL) {
+            a->on_exhausted(a, size);
+        }
         return NULL;
     }
-
-    size_t remanining = node->block_size - required;
-    arena_remove_node(&a->head, prev_node, node);
-
-    if (remanining >= sizeof(arena_block)) {
-        arena_block *new_node = (arena_block *)((char *)node + required);
-        new_node->block_size = remanining;
-        arena_insert_sorted(&a->head, new_node);
-    }
-
-    arena_block_header *header = (arena_block_header *)node;
-    header->block_size = required;
-    header->padding = 0;
-
-    a->used += required;
+    block_split(a, header, size);
+    a->used += block_size(header);
+    count_alloc(a, block_size(header));
+    count_used(a);
 
     return (void *)((char *)header + sizeof(arena_block_header));
 }
@@ -132,80 +241,131 @@ void *arena_realloc(arena *a, void *ptr, size_t size) {
     }
 
     arena_block_header *header = (arena_block_header *)((char *)ptr - sizeof(arena_block_header));
-    size_t old_total = header->block_size;
-    size_t old_user_size = old_total - sizeof(arena_block_header);
-
-    size = align_up(size, alignof(max_align_t)) + sizeof(arena_block_header);
+    size_t old_total = block_size(header);
+    size = block_size_for(size);
 
     if (size <= old_total) {
         return ptr;
     }
 
-    if (a->used + size >= a->size) {
-        assert(0 && "No more free memory");
-        return NULL;
-    }
-
-    arena_block *block = (arena_block *)header;
-    arena_block *next = arena_next_block(a, block);
-
-    if (next) {
-        arena_block *node = a->head;
-        arena_block *prev = NULL;
-        while (node && node != next) {
-            prev = node;
-            node = node->next;
-        }
-
-        if (node) {
-            size_t combined = block->block_size + node->block_size;
-            // Next block is free and we can merge them
-            if (combined >= size) {
-                arena_remove_node(&a->head, prev, node);
-                size_t remanining = combined - size;
-                if (remanining >= sizeof(arena_block)) {
-                    arena_block *split = (arena_block *)((char *)block + size);
-                    split->block_size = remanining;
-                    arena_insert_sorted(&a->head, split);
-                }
-
-                header->block_size = size;
-                a->used += (size - old_total);
-                memset((char *)ptr + old_user_size, 0xAA, size - old_user_size);
-                return ptr;
-            }
+    arena_block_header *next = block_next(header);
+    if (next == a->top) {
+        // Last block before the top, it grows in place
+        if (arena_bump(a, size - old_total) != NULL) {
+            header->size = size | ARENA_IN_USE;
+            a->top->prev_size = size;
+            a->used += size - old_total;
+            count_used(a);
+            return ptr;
         }
+    } else if (!(next->size & ARENA_IN_USE) && old_total + next->size >= size) {
+        // Next block is free and we can merge them
+        free_list_remove(a, (arena_block *)next);
+        header->size = old_total + next->size;
+        block_next(header)->prev_size = header->size;
+        block_split(a, header, size);
+        a->used += block_size(header) - old_total;
+        count_used(a);
+        return ptr;
     }
 
-    void *new_ptr = arena_alloc(a, size);
+    void *new_ptr = arena_alloc(a, size - sizeof(arena_block_header));
     if (new_ptr == NULL) {
         return NULL;
     }
 
-    memcpy(new_ptr, ptr, old_user_size);
+    memcpy(new_ptr, ptr, old_total - sizeof(arena_block_header));
     arena_free_node(a, ptr);
     return new_ptr;
 }
 
+char *arena_strdup(arena *a, const char *s) {
+    size_t size = strlen(s) + 1;
+    char *result = arena_alloc(a, size);
+    if (result != NULL) {
+        memcpy(result, s, size);
+    }
+    return result;
+}
+
 void arena_free_node(arena *a, void *ptr) {
     if (ptr == NULL) {
         return;
     }
 
     arena_block_header *header = (arena_block_header *)((char *)ptr - sizeof(arena_block_header));
-    arena_block *block = (arena_block *)header;
+    size_t size = block_size(header);
+    a->used -= size;
+    count_free(a);
+
+    // Free neighbours are merged so two free blocks are never next to each other
+    if (header->prev_size != 0) {
+        arena_block_header *prev = (arena_block_header *)((char *)header - header->prev_size);
+        if (!(prev->size & ARENA_IN_USE)) {
+            free_list_remove(a, (arena_block *)prev);
+            size += prev->size;
+            header = prev;
+        }
+    }
+    header->size = size;
 
-    size_t block_size = block->block_size;
-    block->block_size = header->block_size;
-    a->used -= block_size;
+    arena_block_header *next = block_next(header);
+    if (next == a->top) {
+        // Given back to the fresh space
+        header->size += a->top->size;
+        a->top = header;
+        return;
+    }
+    if (!(next->size & ARENA_IN_USE)) {
+        free_list_remove(a, (arena_block *)next);
+        header->size += next->size;
+    }
+    block_next(header)->prev_size = header->size;
+    free_list_push(a, (arena_block *)header);
+}
 
-    arena_insert_sorted(&a->head, block);
-    arena_coalesce(&a->head, block);
+size_t arena_class_size(size_t class) {
+    if (class < ARENA_SMALL_CLASSES) {
+        return class * ARENA_ALIGNMENT;
+    }
+    return (size_t)ARENA_SMALL_LIMIT << (class - ARENA_SMALL_CLASSES);
+}
+
+arena_stats arena_get_stats(arena *a) {
+    arena_stats stats = {
+        .used = a->used,
+        .committed = a->size,
+        .limit = a->limit,
+    };
+    // The top counts as one free block, what is not committed yet does not
+    size_t top = a->top->size - sizeof(arena_block_header);
+    if (top > 0) {
+        stats.free_blocks = 1;
+        stats.free_bytes = top;
+        stats.largest_free = top;
+    }
+    for (size_t class = 0; class < ARENA_CLASS_COUNT; class++) {
+        for (arena_block *block = a->free_lists[class]; block != NULL; block = block->next) {
+            stats.free_blocks++;
+            stats.free_bytes += block->header.size;
+            if (block->header.size > stats.largest_free) {
+                stats.largest_free = block->header.size;
+            }
+        }
+    }
+    if (stats.free_bytes > 0) {
+        stats.fragmentation = 100 - (int)(stats.largest_free * 100 / stats.free_bytes);
+    }
+#ifdef ARENA_STATS
+    stats.has_counters = true;
+    stats.counters = a->counters;
+#endif
+    return stats;
 }
 
 void arena_free(arena *a) {
     if (a) {
-        free(a->content);
+        munmap(a->content, a->reserved);
     }
     free(a);
 }
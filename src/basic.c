@@ -1,16 +1,13 @@
 /*
  * TODO:
- *   - Table like in Lua
- *      - Array should just be a table with int key
  *   - Import another file
  *   - More math functions
- *   - Replace int with fixed sized uint16_t for values
- *   - Allow fixed point floating numbers
  *   - Use arena everywhere !!!
  * Bugs:
  *   - Semicolons should be no-op but can cause crashes
  */
 #include "basic.h"
+#include <assert.h>
 #include <ctype.h>
 #include <math.h>
 #include <setjmp.h>
@@ -20,6 +17,7 @@
 #include <string.h>
 #include <sys/ptrace.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include "arena.h"
 #include "basic_internals.h"
@@ -33,11 +31,17 @@ const char *keywords[] = {"KW_NONE", KEYWORDS};
 #undef X
 const size_t keywords_count = sizeof(keywords) / sizeof(keywords[0]);
 
-basic_interpreter *global_interpreter = NULL;
-bool should_go_to_sleep = false;
-arena *interpreter_arena = NULL;
-jmp_buf err_jmp;
-int error_line = 0;
+const char *value_type_names[] = {"integer", "string", "fixed point", "table"};
+
+// Context the public entry points are working on. Every piece of interpreter
+// state lives in the context, this only saves passing it to every internal function.
+_Thread_local basic_interpreter *current_interpreter = NULL;
+
+// Arenas of the running context, see basic_interpreter for what goes where
+#define interpreter_arena (current_interpreter->arena)
+#define interpreter_code_arena (current_interpreter->code_arena)
+#define interpreter_compile_arena (current_interpreter->compile_arena)
+#define interpreter_scratch (current_interpreter->scratch)
 
 // NOTE: from https://forum.juce.com/t/detecting-if-a-process-is-being-run-under-a-debugger/2098
 bool in_debugger() {
@@ -68,22 +72,23 @@ bool in_debugger() {
     do {                                                 \
         BREAKPOINT();                                    \
         interpreter_log(msg __VA_OPT__(, ) __VA_ARGS__); \
-        error_line = __LINE__;                           \
-        longjmp(err_jmp, 1);                             \
+        current_interpreter->error_line = __LINE__;      \
+        longjmp(current_interpreter->err_jmp, 1);        \
     } while (0)
 
 uint16_t read_word();
+uint32_t read_dword();
 void print_program_bytecode() {
     printf("\n==== Program Bytecode ====\n");
-    printf("IP = %zu (%s)\n", global_interpreter->ip, global_interpreter->current_function->name);
-    size_t prev_ip = global_interpreter->ip;
-    for (size_t f = 0; f < global_interpreter->bytecode.count; f++) {
-        printf("\n== %s ==\n", global_interpreter->bytecode.items[f].name);
-        function_code *function = &global_interpreter->bytecode.items[f];
-        while (global_interpreter->ip < function->body.count) {
-            size_t i = global_interpreter->ip++;
+    printf("IP = %zu (%s)\n", current_interpreter->ip, current_interpreter->current_function->name);
+    size_t prev_ip = current_interpreter->ip;
+    for (size_t f = 0; f < current_interpreter->bytecode.count; f++) {
+        printf("\n== %s ==\n", current_interpreter->bytecode.items[f].name);
+        function_code *function = &current_interpreter->bytecode.items[f];
+        while (current_interpreter->ip < function->body.count) {
+            size_t i = current_interpreter->ip++;
             opcode_type op = function->body.items[i];
-            if (global_interpreter->current_function == function && prev_ip == i) {
+            if (current_interpreter->current_function == function && prev_ip == i) {
                 printf("-->");
             }
             printf("%04zu ", i);
@@ -93,14 +98,24 @@ void print_program_bytecode() {
                     break;
                 case OPCODE_CONSTANT_STRING:
                     printf("OPCODE_CONSTANT_STRING");
-                    printf("\t\t%s", global_interpreter->values.items[read_word()].as.string);
+                    printf("\t\t%s", string_cstr(AS_STRING(current_interpreter->values.items[read_word()])));
                     i += 2;
                     break;
                 case OPCODE_CONSTANT_NUMBER:
                     printf("OPCODE_CONSTANT_NUMBER");
-                    printf("\t\t%d", read_word());
+                    printf("\t\t%d", (int16_t)read_word());
                     i += 2;
                     break;
+                case OPCODE_CONSTANT_NUMBER_WIDE:
+                    printf("OPCODE_CONSTANT_NUMBER_WIDE");
+                    printf("\t%d", (int32_t)read_dword());
+                    i += 4;
+                    break;
+                case OPCODE_CONSTANT_FIXED:
+                    printf("OPCODE_CONSTANT_FIXED");
+                    printf("\t\t%f", (int32_t)read_dword() / (double)FIXED_ONE);
+                    i += 4;
+                    break;
                 case OPCODE_EQEQ:
                     printf("OPCODE_EQEQ");
                     break;
@@ -137,11 +152,36 @@ void print_program_bytecode() {
                 case OPCODE_ASSIGN:
                     printf("OPCODE_ASSIGN");
                     break;
+                case OPCODE_TABLE_NEW:
+                    printf("OPCODE_TABLE_NEW");
+                    printf("\t\t%d", read_word());
+                    i += 2;
+                    break;
+                case OPCODE_INDEX_LOAD:
+                    printf("OPCODE_INDEX_LOAD");
+                    break;
+                case OPCODE_INDEX_STORE:
+                    printf("OPCODE_INDEX_STORE");
+                    break;
+                case OPCODE_TABLE_NEXT: {
+                    printf("OPCODE_TABLE_NEXT");
+                    uint16_t offset = read_word();
+                    printf("\t\t%05d", (int16_t)(i + offset + 3));
+                    i += 2;
+                    break;
+                }
                 case OPCODE_FUNCALL:
                     printf("OPCODE_FUNCALL");
                     printf("\t\t\t%d", read_word());
                     i += 2;
                     break;
+                case OPCODE_CALL_NATIVE: {
+                    printf("OPCODE_CALL_NATIVE");
+                    const char *name = current_interpreter->natives.items[read_word()].name;
+                    printf("\t\t%s %d", name, read_word());
+                    i += 4;
+                    break;
+                }
                 case OPCODE_JUMP_IF_FALSE: {
                     printf("OPCODE_JUMP_IF_FALSE");
                     uint16_t offset = read_word();
@@ -169,11 +209,12 @@ void print_program_bytecode() {
             printf("\n");
         }
     }
-    global_interpreter->ip = prev_ip;
+    current_interpreter->ip = prev_ip;
 }
 
-void int_to_str(int n, char *result) {
+void int_to_str(int32_t number, char *result) {
     int i = 0;
+    int64_t n = number;
     int neg = n < 0;
     if (n < 0) {
         n = -n;
@@ -199,19 +240,494 @@ void int_to_str(int n, char *result) {
     }
 }
 
+void fixed_to_str(int32_t fixed, char *result) {
+    int64_t n = fixed;
+    bool neg = n < 0;
+    if (neg) {
+        n = -n;
+    }
+    int64_t integer = n >> FIXED_SHIFT;
+    int64_t decimals = ((n & (FIXED_ONE - 1)) * 10000 + FIXED_ONE / 2) >> FIXED_SHIFT;
+    if (decimals == 10000) {
+        integer++;
+        decimals = 0;
+    }
+    neg = neg && (integer != 0 || decimals != 0);
+    int len = sprintf(result, "%s%lld.%04lld", neg ? "-" : "", (long long)integer, (long long)decimals);
+    // Keep at least one decimal so fixed values are distinguishable from integers
+    while (result[len - 1] == '0' && result[len - 2] != '.') {
+        result[--len] = '\0';
+    }
+}
+
+void interpreter_write(const char *text) {
+    if (*text == '\n') {
+        current_interpreter->print_fn(current_interpreter, text);
+    } else {
+        current_interpreter->append_print_fn(current_interpreter, text);
+    }
+}
+
 void interpreter_log(const char *fmt, ...) {
-    static char buffer[256];
+    char buffer[256];
     va_list args;
 
     va_start(args, fmt);
     vsnprintf(buffer, sizeof(buffer), fmt, args);
     va_end(args);
 
-    if (*buffer == '\n') {
-        global_interpreter->print_fn(buffer);
+    interpreter_write(buffer);
+}
+
+void *gc_alloc(gc_kind kind, size_t size) {
+    gc_heap *gc = &current_interpreter->gc;
+    gc_object *object = gc->free[kind];
+    if (object) {
+        gc->free[kind] = object->next;
+    } else {
+        object = arena_alloc(interpreter_arena, size);
+    }
+    memset(object, 0, size);
+    object->kind = kind;
+    object->next = current_interpreter->gc.young;
+    current_interpreter->gc.young = object;
+    return object;
+}
+
+// Must be called before storing a value inside an object that may already be old
+void gc_write_barrier(gc_object *object) {
+    if (object->old && !object->remembered) {
+        object->remembered = true;
+        arena_append(interpreter_arena, &current_interpreter->gc.remembered, object);
+    }
+}
+
+// Like gc_write_barrier but only the stored value is kept, the object isn't traced again
+void gc_write_barrier_value(gc_object *object, value v) {
+    if (!object->old) {
+        return;
+    }
+    gc_object *target = IS_STRING(v) ? &AS_STRING(v)->gc : IS_TABLE(v) ? &AS_TABLE(v)->gc : NULL;
+    if (target != NULL && !target->old) {
+        arena_append(interpreter_arena, &current_interpreter->gc.remembered_values, v);
+    }
+}
+
+void gc_mark_object(gc_object *object, bool major) {
+    if (object->marked || (object->old && !major)) {
+        return;
+    }
+    object->marked = true;
+    arena_append(interpreter_arena, &current_interpreter->gc.gray, object);
+}
+
+void gc_mark_value(value v, bool major) {
+    if (IS_STRING(v)) {
+        gc_mark_object(&AS_STRING(v)->gc, major);
+    } else if (IS_TABLE(v)) {
+        gc_mark_object(&AS_TABLE(v)->gc, major);
+    }
+}
+
+void gc_trace_object(gc_object *object, bool major) {
+    switch (object->kind) {
+        case GC_STRING:
+            gc_mark_object(&((basic_string *)object)->buffer->gc, major);
+            break;
+        case GC_STRING_BUFFER:
+        case GC_KIND_COUNT:
+            break;
+        case GC_TABLE: {
+            basic_table *t = (basic_table *)object;
+            for (size_t i = 0; i < t->array.count; i++) {
+                gc_mark_value(t->array.items[i], major);
+            }
+            for (size_t i = 0; i < t->hash_capacity; i++) {
+                if (t->entries[i].key != TABLE_EMPTY_KEY) {
+                    gc_mark_value(t->entries[i].key, major);
+                    gc_mark_value(t->entries[i].value, major);
+                }
+            }
+        } break;
+    }
+}
+
+void gc_free_object(gc_object *object) {
+    switch (object->kind) {
+        case GC_STRING:
+            break;
+        case GC_STRING_BUFFER: {
+            string_buffer *buffer = (string_buffer *)object;
+            if (buffer->capacity > 0) {
+                arena_free_node(interpreter_arena, buffer->chars);
+            }
+        } break;
+        case GC_TABLE: {
+            basic_table *t = (basic_table *)object;
+            arena_free_node(interpreter_arena, t->array.items);
+            arena_free_node(interpreter_arena, t->entries);
+        } break;
+        case GC_KIND_COUNT:
+            break;
+    }
+    gc_heap *gc = &current_interpreter->gc;
+    object->next = gc->free[object->kind];
+    gc->free[object->kind] = object;
+}
+
+// Frees unmarked objects, survivors of the nursery are moved to the old generation
+void gc_sweep(gc_object **list, bool promote) {
+    gc_heap *gc = &current_interpreter->gc;
+    while (*list) {
+        gc_object *object = *list;
+        if (!object->marked) {
+            *list = object->next;
+            gc_free_object(object);
+            gc->stats.objects_freed++;
+        } else if (promote) {
+            *list = object->next;
+            object->marked = false;
+            object->old = true;
+            object->next = gc->old;
+            gc->old = object;
+        } else {
+            object->marked = false;
+            list = &object->next;
+        }
+    }
+}
+
+uint64_t gc_time_ns() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void gc_collect(bool major) {
+    gc_heap *gc = &current_interpreter->gc;
+    uint64_t start = gc_time_ns();
+    size_t used_before = interpreter_arena->used;
+
+    for (size_t i = 0; i < current_interpreter->stack.count; i++) {
+        gc_mark_value(current_interpreter->stack.items[i], major);
+    }
+    for (size_t i = 0; i < current_interpreter->symbols_table_count; i++) {
+        symbol *s = &current_interpreter->symbols_table[i];
+        if (s->type == SYMBOL_VARIABLE) {
+            gc_mark_value(s->as.value, major);
+        }
+    }
+    for (size_t i = 0; i < current_interpreter->values.count; i++) {
+        gc_mark_value(current_interpreter->values.items[i], major);
+    }
+    // Old objects written to may hold the only reference to young ones
+    if (!major) {
+        for (size_t i = 0; i < gc->remembered.count; i++) {
+            gc_trace_object(gc->remembered.items[i], major);
+        }
+        for (size_t i = 0; i < gc->remembered_values.count; i++) {
+            gc_mark_value(gc->remembered_values.items[i], major);
+        }
+    }
+    gc->remembered_values.count = 0;
+    while (gc->gray.count > 0) {
+        gc_trace_object(pop(&gc->gray), major);
+    }
+
+    string_intern_purge(major);
+
+    // Before sweeping, a major collection can free remembered objects
+    for (size_t i = 0; i < gc->remembered.count; i++) {
+        gc->remembered.items[i]->remembered = false;
+    }
+    gc->remembered.count = 0;
+
+    if (major) {
+        gc_sweep(&gc->old, false);
+    }
+    gc_sweep(&gc->young, true);
+    gc->young = NULL;
+
+    size_t used = interpreter_arena->used;
+    gc->stats.bytes_freed += used_before > used ? used_before - used : 0;
+    gc->next_minor = used + GC_NURSERY_BYTES;
+    if (major) {
+        gc->major_requested = false;
+        gc->next_major = used * 2 > GC_MIN_MAJOR_BYTES ? used * 2 : GC_MIN_MAJOR_BYTES;
+        gc->stats.major_collections++;
+        // A single big temporary would otherwise keep its pages for the whole run
+        if (interpreter_scratch->size > ARENA_CHUNK_SIZE) {
+            arena_reset(interpreter_scratch);
+        }
+    } else {
+        gc->stats.minor_collections++;
+    }
+
+    uint64_t pause = gc_time_ns() - start;
+    gc->stats.last_pause_ns = pause;
+    gc->stats.total_pause_ns += pause;
+    if (pause > gc->stats.max_pause_ns) {
+        gc->stats.max_pause_ns = pause;
+    }
+}
+
+basic_gc_stats basic_get_gc_stats(basic_ctx *ctx) {
+    return ctx->gc.stats;
+}
+
+arena_stats basic_get_memory_stats(basic_ctx *ctx) {
+    return arena_get_stats(ctx->arena);
+}
+
+uint64_t hash_chars(const char *chars, size_t length) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)chars[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+uint64_t string_hash(basic_string *s) {
+    if (s->hash == 0) {
+        s->hash = hash_chars(string_chars(s), s->length);
+    }
+    return s->hash;
+}
+
+bool strings_equal(basic_string *a, basic_string *b) {
+    if (a == b) {
+        return true;
+    }
+    if ((a->interned && b->interned) || a->length != b->length) {
+        return false;
+    }
+    if (a->hash != 0 && b->hash != 0 && a->hash != b->hash) {
+        return false;
+    }
+    return memcmp(string_chars(a), string_chars(b), a->length) == 0;
+}
+
+// Like strcmp but strings may contain any byte
+int strings_compare(basic_string *a, basic_string *b) {
+    size_t length = a->length < b->length ? a->length : b->length;
+    int order = memcmp(string_chars(a), string_chars(b), length);
+    if (order != 0) {
+        return order;
+    }
+    return (a->length > b->length) - (a->length < b->length);
+}
+
+basic_string **string_intern_slot(const char *chars, size_t length, uint64_t hash) {
+    gc_heap *gc = &current_interpreter->gc;
+    size_t mask = gc->interned.capacity - 1;
+    size_t i = hash & mask;
+    while (gc->interned.items[i] != NULL) {
+        basic_string *s = gc->interned.items[i];
+        if (s->hash == hash && s->length == length && memcmp(string_chars(s), chars, length) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &gc->interned.items[i];
+}
+
+void string_intern_rehash(size_t capacity) {
+    gc_heap *gc = &current_interpreter->gc;
+    basic_string **old_items = gc->interned.items;
+    size_t old_capacity = gc->interned.capacity;
+
+    gc->interned.capacity = capacity;
+    gc->interned.items = arena_alloc(interpreter_arena, sizeof(*gc->interned.items) * capacity);
+    memset(gc->interned.items, 0, sizeof(*gc->interned.items) * capacity);
+    gc->interned.count = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        basic_string *s = old_items[i];
+        if (s != NULL && s->interned) {
+            *string_intern_slot(string_chars(s), s->length, s->hash) = s;
+            gc->interned.count++;
+        }
+    }
+    arena_free_node(interpreter_arena, old_items);
+}
+
+// Returns the interned string with these chars, or NULL and the slot where it goes
+basic_string *string_find_interned(const char *chars, size_t length, uint64_t hash, basic_string ***slot) {
+    gc_heap *gc = &current_interpreter->gc;
+    if ((gc->interned.count + 1) * 4 > gc->interned.capacity * 3) {
+        string_intern_rehash(gc->interned.capacity == 0 ? 256 : gc->interned.capacity * 2);
+    }
+    *slot = string_intern_slot(chars, length, hash);
+    return **slot;
+}
+
+// Entries after the removed one are shifted back so probing never stops early
+void string_intern_remove(basic_string *s) {
+    gc_heap *gc = &current_interpreter->gc;
+    size_t mask = gc->interned.capacity - 1;
+    size_t hole = s->hash & mask;
+    while (gc->interned.items[hole] != s) {
+        hole = (hole + 1) & mask;
+    }
+    for (size_t i = (hole + 1) & mask; gc->interned.items[i] != NULL; i = (i + 1) & mask) {
+        size_t home = gc->interned.items[i]->hash & mask;
+        // Moves back unless its home slot lies in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            gc->interned.items[hole] = gc->interned.items[i];
+            hole = i;
+        }
+    }
+    gc->interned.items[hole] = NULL;
+    gc->interned.count--;
+    s->interned = false;
+}
+
+// Called by the collector once marking is done, interned strings don't keep themselves alive.
+// A minor collection only looks at the nursery, the table can be much bigger.
+void string_intern_purge(bool major) {
+    gc_heap *gc = &current_interpreter->gc;
+    if (!major) {
+        for (gc_object *object = gc->young; object != NULL; object = object->next) {
+            basic_string *s = (basic_string *)object;
+            if (object->kind == GC_STRING && !object->marked && s->interned) {
+                string_intern_remove(s);
+            }
+        }
+        return;
+    }
+    bool purged = false;
+    for (size_t i = 0; i < gc->interned.capacity; i++) {
+        basic_string *s = gc->interned.items[i];
+        if (s != NULL && !s->gc.marked) {
+            s->interned = false;
+            purged = true;
+        }
+    }
+    if (purged) {
+        string_intern_rehash(gc->interned.capacity);
+    }
+}
+
+// Short strings are copied and interned, the others are wrapped without copying
+basic_string *string_wrap(const char *chars) {
+    size_t length = strlen(chars);
+    basic_string **slot = NULL;
+    uint64_t hash = 0;
+    if (length <= STRING_INTERN_MAX_LENGTH) {
+        hash = hash_chars(chars, length);
+        basic_string *existing = string_find_interned(chars, length, hash, &slot);
+        if (existing) {
+            return existing;
+        }
+    }
+
+    string_buffer *buffer = gc_alloc(GC_STRING_BUFFER, sizeof(*buffer));
+    buffer->length = length;
+    if (slot) {
+        // Interned strings outlive the caller's chars
+        buffer->capacity = length + 1;
+        buffer->chars = arena_alloc(interpreter_arena, buffer->capacity + 1);
+        memcpy(buffer->chars, chars, length + 1);
     } else {
-        global_interpreter->append_print_fn(buffer);
+        buffer->chars = (char *)chars;
+        buffer->capacity = 0;
+    }
+    basic_string *string = gc_alloc(GC_STRING, sizeof(*string));
+    string->buffer = buffer;
+    string->length = length;
+    if (slot) {
+        string->hash = hash;
+        string->interned = true;
+        *slot = string;
+        current_interpreter->gc.interned.count++;
+    }
+    return string;
+}
+
+// Returns the interned string when the range is short enough, nothing is copied either way
+basic_string *string_new(string_buffer *buffer, size_t offset, size_t length) {
+    const char *chars = buffer->chars + offset;
+    basic_string **slot = NULL;
+    uint64_t hash = 0;
+    if (length <= STRING_INTERN_MAX_LENGTH) {
+        hash = hash_chars(chars, length);
+        basic_string *existing = string_find_interned(chars, length, hash, &slot);
+        if (existing) {
+            return existing;
+        }
+    }
+
+    basic_string *result = gc_alloc(GC_STRING, sizeof(*result));
+    result->buffer = buffer;
+    result->offset = offset;
+    result->length = length;
+    if (slot) {
+        result->hash = hash;
+        result->interned = true;
+        *slot = result;
+        current_interpreter->gc.interned.count++;
+    }
+    return result;
+}
+
+// Amortized O(1) when s is the last string built on its buffer, like an accumulator in a loop
+basic_string *string_append(basic_string *s, const char *chars, size_t length) {
+    string_buffer *buffer = s->buffer;
+    size_t offset = s->offset;
+    bool owns_tail = buffer->capacity > 0 && offset + s->length == buffer->length;
+    if (!owns_tail) {
+        string_buffer *copy = gc_alloc(GC_STRING_BUFFER, sizeof(*copy));
+        copy->capacity = s->length + length;
+        copy->chars = arena_alloc(interpreter_arena, copy->capacity + 1);
+        copy->length = s->length;
+        memcpy(copy->chars, string_chars(s), s->length);
+        buffer = copy;
+        offset = 0;
+    }
+
+    size_t required = buffer->length + length;
+    if (required > buffer->capacity) {
+        // chars may point into this buffer when appending a string built on it
+        bool aliased = chars >= buffer->chars && chars <= buffer->chars + buffer->length;
+        size_t chars_offset = chars - buffer->chars;
+        size_t capacity = buffer->capacity * 2;
+        buffer->capacity = capacity > required ? capacity : required;
+        buffer->chars = arena_realloc(interpreter_arena, buffer->chars, buffer->capacity + 1);
+        if (aliased) {
+            chars = buffer->chars + chars_offset;
+        }
+    }
+    memcpy(buffer->chars + buffer->length, chars, length);
+    buffer->length = required;
+    buffer->chars[required] = '\0';
+
+    return string_new(buffer, offset, required - offset);
+}
+
+// Callers clamp the range, the slice shares the chars of s
+basic_string *string_slice(basic_string *s, size_t offset, size_t length) {
+    if (offset == 0 && length == s->length) {
+        return s;
+    }
+    return string_new(s->buffer, s->offset + offset, length);
+}
+
+// Only slices and strings that have been appended to since they were built need to be copied
+const char *string_cstr(basic_string *s) {
+    if (s->offset + s->length == s->buffer->length) {
+        return string_chars(s);
     }
+    string_buffer *copy = gc_alloc(GC_STRING_BUFFER, sizeof(*copy));
+    copy->chars = arena_alloc(interpreter_arena, s->length + 1);
+    copy->length = s->length;
+    copy->capacity = s->length;
+    memcpy(copy->chars, string_chars(s), s->length);
+    copy->chars[s->length] = '\0';
+    gc_write_barrier(&s->gc);
+    s->buffer = copy;
+    s->offset = 0;
+    return copy->chars;
 }
 
 void print_token(token *t) {
@@ -266,6 +782,13 @@ token next(const char *input) {
         result.type = TOKEN_NUMBER;
         while (isdigit(*input))
             input++;
+        // A dot followed by a digit is a fixed point literal, `0..10` is still a range
+        if (input[0] == '.' && isdigit(input[1])) {
+            result.type = TOKEN_FIXED;
+            input++;
+            while (isdigit(*input))
+                input++;
+        }
     } else if (*input == '+') {
         result.type = TOKEN_PLUS;
         input++;
@@ -294,6 +817,18 @@ token next(const char *input) {
     } else if (*input == ')') {
         result.type = TOKEN_RPAREN;
         input++;
+    } else if (*input == '[') {
+        result.type = TOKEN_LBRACKET;
+        input++;
+    } else if (*input == ']') {
+        result.type = TOKEN_RBRACKET;
+        input++;
+    } else if (*input == '{') {
+        result.type = TOKEN_LBRACE;
+        input++;
+    } else if (*input == '}') {
+        result.type = TOKEN_RBRACE;
+        input++;
     } else if (*input == '!') {
         input++;
         if (*input && *input == '=') {
@@ -344,15 +879,12 @@ token next(const char *input) {
 }
 
 #define MAX_TOKENS 1024 * 1024
-token tokens[MAX_TOKENS] = {0};
-size_t token_count = 0;
-size_t parser_reader = 0;
 
 void lexical_analysis(const char *input) {
     while (1) {
         token tok = next(input);
-        tokens[token_count++] = tok;
-        if (token_count == MAX_TOKENS) {
+        arena_append(interpreter_compile_arena, &current_interpreter->parser.tokens, tok);
+        if (current_interpreter->parser.tokens.count == MAX_TOKENS) {
             ERR("Program is too big... (%d tokens max)\n", MAX_TOKENS);
         }
         input = tok.end;
@@ -362,7 +894,7 @@ void lexical_analysis(const char *input) {
 }
 
 token *parser_peek() {
-    return &tokens[parser_reader];
+    return &current_interpreter->parser.tokens.items[current_interpreter->parser.reader];
 }
 
 bool peek_type(token_type type) {
@@ -375,7 +907,7 @@ bool peek_kw(keyword_type type) {
 
 token *parser_next() {
     token *result = parser_peek();
-    parser_reader++;
+    current_interpreter->parser.reader++;
     return result;
 }
 
@@ -392,13 +924,13 @@ token *expect_kw(keyword_type type) {
     if (read->keyword != type) {
         ERR("Expecting keyword %s but got %s : ", keywords[type], keywords[read->keyword]);
     }
-    parser_reader++;
+    current_interpreter->parser.reader++;
     return read;
 }
 
 bool match(token_type type) {
     if (parser_peek()->type == type) {
-        parser_reader++;
+        current_interpreter->parser.reader++;
         return true;
     }
     return false;
@@ -413,58 +945,111 @@ const char *tok_to_str(token *tok) {
         len -= 2;
     }
 
-    char *result = arena_alloc(interpreter_arena, len + 1);
+    char *result = arena_alloc(interpreter_code_arena, len + 1);
     memset(result, 0, len + 1);
     strncpy(result, start, len);
     return result;
 }
 
-int tok_to_num(token *tok) {
+int32_t tok_to_num(token *tok) {
     if (tok->type != TOKEN_NUMBER) {
         ERR("Trying to convert from not a number to a number");
     }
-    int result = 0;
+    int64_t result = 0;
     const char *str = tok->start;
     for (; str != tok->end; str++) {
         result *= 10;
         result += ((*str) - '0');
+        if (result > INT32_MAX) {
+            ERR("Number %.*s is too big (max %d)", (int)(tok->end - tok->start), tok->start, INT32_MAX);
+        }
+    }
+    return result;
+}
+
+int32_t tok_to_fixed(token *tok) {
+    if (tok->type != TOKEN_FIXED) {
+        ERR("Trying to convert from not a fixed point number to a fixed point number");
+    }
+    const char *str = tok->start;
+    int64_t integer = 0;
+    for (; *str != '.'; str++) {
+        integer = integer * 10 + ((*str) - '0');
+        if (integer > (INT32_MAX >> FIXED_SHIFT)) {
+            break;
+        }
+    }
+    str = (const char *)memchr(str, '.', tok->end - str) + 1;
+
+    int64_t decimals = 0;
+    int64_t scale = 1;
+    // Digits past the Q16.16 precision do not change the result
+    for (; str != tok->end && scale < 1000000000; str++) {
+        decimals = decimals * 10 + ((*str) - '0');
+        scale *= 10;
+    }
+    int64_t result = (integer << FIXED_SHIFT) + (decimals * FIXED_ONE + scale / 2) / scale;
+    if (result > INT32_MAX) {
+        ERR("Number %.*s is too big (max %d)", (int)(tok->end - tok->start), tok->start, INT32_MAX >> FIXED_SHIFT);
     }
     return result;
 }
 
 size_t emit_opcode(opcode_type type) {
-    size_t prev = global_interpreter->current_function->body.count;
-    arena_append(&global_interpreter->current_function->body, type);
+    size_t prev = current_interpreter->current_function->body.count;
+    arena_append(interpreter_code_arena, &current_interpreter->current_function->body, type);
     return prev;
 }
 
 size_t emit_word(uint16_t byte) {
-    size_t prev = global_interpreter->current_function->body.count;
-    arena_append(&global_interpreter->current_function->body, byte & 0xFF);
-    arena_append(&global_interpreter->current_function->body, (byte >> 8) & 0xFF);
+    size_t prev = current_interpreter->current_function->body.count;
+    arena_append(interpreter_code_arena, &current_interpreter->current_function->body, byte & 0xFF);
+    arena_append(interpreter_code_arena, &current_interpreter->current_function->body, (byte >> 8) & 0xFF);
     return prev;
 }
 
 uint16_t read_word() {
     uint16_t result = 0;
-    result += global_interpreter->current_function->body.items[global_interpreter->ip++] & 0xFF;
-    result += (global_interpreter->current_function->body.items[global_interpreter->ip++] & 0xFF) << 8;
+    result += current_interpreter->current_function->body.items[current_interpreter->ip++] & 0xFF;
+    result += (current_interpreter->current_function->body.items[current_interpreter->ip++] & 0xFF) << 8;
+    return result;
+}
+
+void emit_dword(uint32_t dword) {
+    emit_word(dword & 0xFFFF);
+    emit_word((dword >> 16) & 0xFFFF);
+}
+
+uint32_t read_dword() {
+    uint32_t result = read_word();
+    result |= (uint32_t)read_word() << 16;
     return result;
 }
 
 int emit_value(value v) {
-    arena_append(&global_interpreter->values, v);
-    return global_interpreter->values.count - 1;
+    arena_append(interpreter_code_arena, &current_interpreter->values, v);
+    return current_interpreter->values.count - 1;
+}
+
+void emit_constant_number(int32_t num) {
+    // Most constants are small, only pay for the 32-bit operand when needed
+    if (num >= INT16_MIN && num <= INT16_MAX) {
+        emit_opcode(OPCODE_CONSTANT_NUMBER);
+        emit_word(num);
+    } else {
+        emit_opcode(OPCODE_CONSTANT_NUMBER_WIDE);
+        emit_dword(num);
+    }
 }
 
-void emit_constant_number(uint16_t num) {
-    emit_opcode(OPCODE_CONSTANT_NUMBER);
-    emit_word(num);
+void emit_constant_fixed(int32_t fixed) {
+    emit_opcode(OPCODE_CONSTANT_FIXED);
+    emit_dword(fixed);
 }
 
 void emit_constant_string(const char *str) {
     emit_opcode(OPCODE_CONSTANT_STRING);
-    int index = emit_value((value){.type = VAL_STRING, .as.string = str});
+    int index = emit_value(STRING_VAL(string_wrap(str)));
     emit_word(index);
 }
 
@@ -476,19 +1061,88 @@ void emit_variable_value(const char *var) {
 void compile_expr();
 void compile_block();
 
-void compile_identifier() {
-    token *tok = parser_next();
-    if (peek_type(TOKEN_LPAREN)) {
-        expect(TOKEN_LPAREN);
-        size_t arg_count = 0;
-        while (!peek_type(TOKEN_RPAREN)) {
-            compile_expr();
-            arg_count++;
+symbol *get_symbol(const char *name);
+
+// Type of the argument compiled from start if it is a single constant, the other
+// arguments are only known when the call runs
+bool literal_type(size_t start, value_type *type) {
+    function_code *f = current_interpreter->current_function;
+    size_t length = f->body.count - start;
+    switch (f->body.items[start]) {
+        case OPCODE_CONSTANT_NUMBER:
+            *type = VAL_NUM;
+            return length == 3;
+        case OPCODE_CONSTANT_NUMBER_WIDE:
+            *type = VAL_NUM;
+            return length == 5;
+        case OPCODE_CONSTANT_FIXED:
+            *type = VAL_FIXED;
+            return length == 5;
+        case OPCODE_CONSTANT_STRING:
+            *type = VAL_STRING;
+            return length == 3;
+        default:
+            return false;
+    }
+}
+
+// Types accepted by the i-th argument, extra arguments of a variadic native share the last entry
+uint8_t native_arg_types(const native_function *native, size_t i) {
+    if (i < native->arg_count) {
+        return native->arg_types[i];
+    }
+    return native->variadic ? native->arg_types[native->arg_count] : 0xFF;
+}
+
+// Natives are bound when the call is compiled so the arity, the argument types
+// of constants and whether a result is available are checked once, here.
+void compile_call(const char *name, bool statement) {
+    expect(TOKEN_LPAREN);
+    symbol *s = get_symbol(name);
+    native_function *native = NULL;
+    if (s != NULL && s->type == SYMBOL_FUNCTION_NATIVE) {
+        native = &current_interpreter->natives.items[s->as.native];
+    }
+
+    size_t arg_count = 0;
+    while (!peek_type(TOKEN_RPAREN)) {
+        size_t start = current_interpreter->current_function->body.count;
+        compile_expr();
+        value_type type;
+        if (native && literal_type(start, &type) && !(native_arg_types(native, arg_count) & (1 << type))) {
+            ERR("Function %s does not accept a %s as argument %zu", name, value_type_names[type], arg_count + 1);
         }
-        expect(TOKEN_RPAREN);
-        emit_constant_string(tok_to_str(tok));
+        arg_count++;
+    }
+    expect(TOKEN_RPAREN);
+
+    if (native == NULL) {
+        emit_constant_string(name);
         emit_opcode(OPCODE_FUNCALL);
         emit_word(arg_count);
+        if (statement) {
+            emit_opcode(OPCODE_DISCARD);
+        }
+        return;
+    }
+    if (arg_count < native->arg_count || (arg_count > native->arg_count && !native->variadic)) {
+        ERR("Function %s expected %u args but recieved %zu", name, native->arg_count, arg_count);
+    }
+    if (!statement && !native->returns) {
+        ERR("Function %s does not return a value", name);
+    }
+    emit_opcode(OPCODE_CALL_NATIVE);
+    emit_word(s->as.native);
+    emit_word(arg_count);
+    if (statement && native->returns) {
+        emit_opcode(OPCODE_DISCARD);
+    }
+}
+
+void compile_identifier() {
+    token *tok = parser_next();
+    if (peek_type(TOKEN_LPAREN)) {
+        compile_call(tok_to_str(tok), false);
     } else {
         emit_variable_value(tok_to_str(tok));
     }
@@ -509,10 +1163,23 @@ void compile_primary() {
     } else if (peek_type(TOKEN_NUMBER)) {
         token *number = expect(TOKEN_NUMBER);
         emit_constant_number(tok_to_num(number));
+    } else if (peek_type(TOKEN_FIXED)) {
+        token *number = expect(TOKEN_FIXED);
+        emit_constant_fixed(tok_to_fixed(number));
     } else if (peek_type(TOKEN_LPAREN)) {
         parser_next();
         compile_expr();
         expect(TOKEN_RPAREN);
+    } else if (peek_type(TOKEN_LBRACE)) {
+        parser_next();
+        size_t item_count = 0;
+        while (!peek_type(TOKEN_RBRACE) && !peek_type(TOKEN_EOF)) {
+            compile_expr();
+            item_count++;
+        }
+        expect(TOKEN_RBRACE);
+        emit_opcode(OPCODE_TABLE_NEW);
+        emit_word(item_count);
     } else {
         if (!peek_type(TOKEN_RPAREN)) {
             ERR("Unexpected %s in expr compilation\n", token_string[parser_peek()->type]);
@@ -520,13 +1187,27 @@ void compile_primary() {
     }
 }
 
+void compile_index() {
+    expect(TOKEN_LBRACKET);
+    compile_expr();
+    expect(TOKEN_RBRACKET);
+}
+
+void compile_postfix() {
+    compile_primary();
+    while (peek_type(TOKEN_LBRACKET)) {
+        compile_index();
+        emit_opcode(OPCODE_INDEX_LOAD);
+    }
+}
+
 void compile_unary() {
     if (peek_type(TOKEN_MINUS)) {
         expect(TOKEN_MINUS);
         compile_unary();
         emit_opcode(OPCODE_NEGATE);
     } else {
-        compile_primary();
+        compile_postfix();
     }
 }
 
@@ -590,9 +1271,9 @@ void compile_and() {
         emit_opcode(OPCODE_JUMP_IF_FALSE);
         size_t jmp = emit_word(0);
         compile_and();
-        uint16_t and_jmp_index = global_interpreter->current_function->body.count - jmp - 2;
-        global_interpreter->current_function->body.items[jmp] = and_jmp_index & 0xFF;
-        global_interpreter->current_function->body.items[jmp + 1] = (and_jmp_index >> 8) & 0xFF;
+        uint16_t and_jmp_index = current_interpreter->current_function->body.count - jmp - 2;
+        current_interpreter->current_function->body.items[jmp] = and_jmp_index & 0xFF;
+        current_interpreter->current_function->body.items[jmp + 1] = (and_jmp_index >> 8) & 0xFF;
     }
 }
 
@@ -612,15 +1293,15 @@ void compile_or() {
         emit_opcode(OPCODE_JUMP);
         size_t end_jmp = emit_word(0);
 
-        uint16_t else_jmp_index = global_interpreter->current_function->body.count - else_jmp - 2;
-        global_interpreter->current_function->body.items[else_jmp] = else_jmp_index & 0xFF;
-        global_interpreter->current_function->body.items[else_jmp + 1] = (else_jmp_index >> 8) & 0xFF;
+        uint16_t else_jmp_index = current_interpreter->current_function->body.count - else_jmp - 2;
+        current_interpreter->current_function->body.items[else_jmp] = else_jmp_index & 0xFF;
+        current_interpreter->current_function->body.items[else_jmp + 1] = (else_jmp_index >> 8) & 0xFF;
 
         compile_or();
 
-        uint16_t end_jmp_index = global_interpreter->current_function->body.count - end_jmp - 2;
-        global_interpreter->current_function->body.items[end_jmp] = end_jmp_index & 0xFF;
-        global_interpreter->current_function->body.items[end_jmp + 1] = (end_jmp_index >> 8) & 0xFF;
+        uint16_t end_jmp_index = current_interpreter->current_function->body.count - end_jmp - 2;
+        current_interpreter->current_function->body.items[end_jmp] = end_jmp_index & 0xFF;
+        current_interpreter->current_function->body.items[end_jmp + 1] = (end_jmp_index >> 8) & 0xFF;
     }
 }
 
@@ -628,8 +1309,52 @@ void compile_expr() {
     compile_or();
 }
 
-bool inside_function_declaration = false;
-const char *last_function = NULL;
+// Compiler temporaries live in variables user code cannot name
+const char *hidden_variable_name(const char *prefix) {
+    char *name = arena_alloc(interpreter_code_arena, 32);
+    snprintf(name, 32, "$%s%zu", prefix, current_interpreter->parser.hidden_variable_count++);
+    return name;
+}
+
+void compile_for_table(const char *key_name, const char *value_name) {
+    const char *table_name = hidden_variable_name("table");
+    const char *cursor_name = hidden_variable_name("cursor");
+    emit_constant_string(table_name);
+    emit_opcode(OPCODE_ASSIGN);
+    emit_constant_number(0);
+    emit_constant_string(cursor_name);
+    emit_opcode(OPCODE_ASSIGN);
+
+    size_t loop_start = current_interpreter->current_function->body.count;
+    emit_variable_value(table_name);
+    emit_variable_value(cursor_name);
+    emit_opcode(OPCODE_TABLE_NEXT);
+    emit_word(0);
+    size_t loop_jump = current_interpreter->current_function->body.count;
+
+    if (value_name) {
+        emit_constant_string(value_name);
+        emit_opcode(OPCODE_ASSIGN);
+    } else {
+        emit_opcode(OPCODE_DISCARD);
+    }
+    emit_constant_string(key_name);
+    emit_opcode(OPCODE_ASSIGN);
+    emit_constant_string(cursor_name);
+    emit_opcode(OPCODE_ASSIGN);
+
+    compile_block();
+    expect_kw(KW_END);
+
+    size_t end = current_interpreter->current_function->body.count;
+
+    emit_opcode(OPCODE_JUMP);
+    emit_word(loop_start - end - 3);
+
+    uint16_t jmp_index = end - loop_jump + 3;
+    current_interpreter->current_function->body.items[loop_jump - 2] = jmp_index & 0xFF;
+    current_interpreter->current_function->body.items[loop_jump - 1] = (jmp_index >> 8) & 0xFF;
+}
 
 void compile_statement() {
     if (peek_type(TOKEN_IDENTIFIER)) {
@@ -641,18 +1366,19 @@ void compile_statement() {
             emit_constant_string(tok_to_str(id));
             emit_opcode(OPCODE_ASSIGN);
         } else if (peek_type(TOKEN_LPAREN)) {
-            expect(TOKEN_LPAREN);
-            size_t arg_count = 0;
-            while (!peek_type(TOKEN_RPAREN)) {
-                compile_expr();
-                arg_count++;
+            compile_call(tok_to_str(id), true);
+            expect(TOKEN_SEMICOLON);
+        } else if (peek_type(TOKEN_LBRACKET)) {
+            emit_variable_value(tok_to_str(id));
+            compile_index();
+            while (peek_type(TOKEN_LBRACKET)) {
+                emit_opcode(OPCODE_INDEX_LOAD);
+                compile_index();
             }
-            expect(TOKEN_RPAREN);
+            expect(TOKEN_EQUAL);
+            compile_expr();
             expect(TOKEN_SEMICOLON);
-            emit_constant_string(tok_to_str(id));
-            emit_opcode(OPCODE_FUNCALL);
-            emit_word(arg_count);
-            emit_opcode(OPCODE_DISCARD);
+            emit_opcode(OPCODE_INDEX_STORE);
         } else {
             ERR("Unknown identifier %s", tok_to_str(id));
         }
@@ -670,29 +1396,29 @@ void compile_statement() {
         emit_opcode(OPCODE_JUMP_IF_FALSE);
         emit_word(0);
 
-        size_t saved = global_interpreter->current_function->body.count;
+        size_t saved = current_interpreter->current_function->body.count;
         compile_block();
-        size_t after = global_interpreter->current_function->body.count;
+        size_t after = current_interpreter->current_function->body.count;
 
         if (peek_kw(KW_ELSE)) {
             parser_next();
             emit_opcode(OPCODE_JUMP);
             emit_word(0);
-            size_t else_saved = global_interpreter->current_function->body.count;
+            size_t else_saved = current_interpreter->current_function->body.count;
             compile_block();
-            size_t else_after = global_interpreter->current_function->body.count;
+            size_t else_after = current_interpreter->current_function->body.count;
 
             uint16_t after_index = after - saved + 3;
-            global_interpreter->current_function->body.items[saved - 2] = after_index & 0xFF;
-            global_interpreter->current_function->body.items[saved - 1] = (after_index >> 8) & 0xFF;
+            current_interpreter->current_function->body.items[saved - 2] = after_index & 0xFF;
+            current_interpreter->current_function->body.items[saved - 1] = (after_index >> 8) & 0xFF;
 
             uint16_t else_saved_index = else_after - else_saved;
-            global_interpreter->current_function->body.items[else_saved - 2] = else_saved_index & 0xFF;
-            global_interpreter->current_function->body.items[else_saved - 1] = (else_saved_index >> 8) & 0xFF;
+            current_interpreter->current_function->body.items[else_saved - 2] = else_saved_index & 0xFF;
+            current_interpreter->current_function->body.items[else_saved - 1] = (else_saved_index >> 8) & 0xFF;
         } else {
             uint16_t after_index = after - saved;
-            global_interpreter->current_function->body.items[saved - 2] = after_index & 0xFF;
-            global_interpreter->current_function->body.items[saved - 1] = (after_index >> 8) & 0xFF;
+            current_interpreter->current_function->body.items[saved - 2] = after_index & 0xFF;
+            current_interpreter->current_function->body.items[saved - 1] = (after_index >> 8) & 0xFF;
         }
 
         expect_kw(KW_END);
@@ -700,22 +1426,31 @@ void compile_statement() {
         parser_next();
         token *tok = expect(TOKEN_IDENTIFIER);
         const char *variable_name = tok_to_str(tok);
+        const char *value_name = NULL;
+        if (peek_type(TOKEN_IDENTIFIER)) {
+            value_name = tok_to_str(expect(TOKEN_IDENTIFIER));
+        }
         expect_kw(KW_IN);
 
         compile_expr();
+        if (value_name || peek_type(TOKEN_SEMICOLON)) {
+            expect(TOKEN_SEMICOLON);
+            compile_for_table(variable_name, value_name);
+            return;
+        }
         emit_constant_string(variable_name);
         emit_opcode(OPCODE_ASSIGN);
         expect(TOKEN_DOT);
         expect(TOKEN_DOT);
 
-        size_t loop_start = global_interpreter->current_function->body.count;
+        size_t loop_start = current_interpreter->current_function->body.count;
         compile_expr();
         expect(TOKEN_SEMICOLON);
         emit_variable_value(variable_name);
         emit_opcode(OPCODE_GT);
         emit_opcode(OPCODE_JUMP_IF_FALSE);
         emit_word(0);
-        size_t loop_jump = global_interpreter->current_function->body.count;
+        size_t loop_jump = current_interpreter->current_function->body.count;
 
         compile_block();
         expect_kw(KW_END);
@@ -726,74 +1461,72 @@ void compile_statement() {
         emit_constant_string(variable_name);
         emit_opcode(OPCODE_ASSIGN);
 
-        size_t end = global_interpreter->current_function->body.count;
+        size_t end = current_interpreter->current_function->body.count;
 
         emit_opcode(OPCODE_JUMP);
         emit_word(loop_start - end - 3);
 
         uint16_t jmp_index = end - loop_jump + 3;
-        global_interpreter->current_function->body.items[loop_jump - 2] = jmp_index & 0xFF;
-        global_interpreter->current_function->body.items[loop_jump - 1] = (jmp_index >> 8) & 0xFF;
+        current_interpreter->current_function->body.items[loop_jump - 2] = jmp_index & 0xFF;
+        current_interpreter->current_function->body.items[loop_jump - 1] = (jmp_index >> 8) & 0xFF;
     } else if (peek_kw(KW_WHILE)) {
         parser_next();
 
-        size_t loop_start = global_interpreter->current_function->body.count;
+        size_t loop_start = current_interpreter->current_function->body.count;
         compile_expr();
         expect(TOKEN_SEMICOLON);
         emit_opcode(OPCODE_JUMP_IF_FALSE);
         emit_word(0);
-        size_t loop_jump = global_interpreter->current_function->body.count;
+        size_t loop_jump = current_interpreter->current_function->body.count;
 
         compile_block();
         expect_kw(KW_END);
 
-        size_t end = global_interpreter->current_function->body.count;
+        size_t end = current_interpreter->current_function->body.count;
 
         emit_opcode(OPCODE_JUMP);
         emit_word(loop_start - end - 3);
 
         uint16_t jmp_index = end - loop_jump + 3;
-        global_interpreter->current_function->body.items[loop_jump - 2] = jmp_index & 0xFF;
-        global_interpreter->current_function->body.items[loop_jump - 1] = (jmp_index >> 8) & 0xFF;
+        current_interpreter->current_function->body.items[loop_jump - 2] = jmp_index & 0xFF;
+        current_interpreter->current_function->body.items[loop_jump - 1] = (jmp_index >> 8) & 0xFF;
     } else if (peek_kw(KW_FUNC)) {
         parser_next();
         const char *function_name = tok_to_str(expect(TOKEN_IDENTIFIER));
-        if (inside_function_declaration) {
+        if (current_interpreter->parser.inside_function_declaration) {
             ERR("Nested function declaration are not allowed.\nTrying to define %s inside %s", function_name,
-                last_function);
+                current_interpreter->parser.last_function);
         }
         function_code new_func = {.name = function_name};
         expect(TOKEN_LPAREN);
         while (!peek_type(TOKEN_RPAREN) && !peek_type(TOKEN_EOF)) {
             token *arg = expect(TOKEN_IDENTIFIER);
-            arena_append(&new_func.args, tok_to_str(arg));
+            arena_append(interpreter_code_arena, &new_func.args, tok_to_str(arg));
         }
         expect(TOKEN_RPAREN);
         expect(TOKEN_SEMICOLON);
-        arena_append(&global_interpreter->bytecode, new_func);
-        global_interpreter->current_function =
-            &global_interpreter->bytecode.items[global_interpreter->bytecode.count - 1];
+        arena_append(interpreter_code_arena, &current_interpreter->bytecode, new_func);
+        current_interpreter->current_function =
+            &current_interpreter->bytecode.items[current_interpreter->bytecode.count - 1];
         {
-            inside_function_declaration = true;
-            last_function = function_name;
+            current_interpreter->parser.inside_function_declaration = true;
+            current_interpreter->parser.last_function = function_name;
             compile_block();
-            inside_function_declaration = false;
-            last_function = NULL;
+            current_interpreter->parser.inside_function_declaration = false;
+            current_interpreter->parser.last_function = NULL;
             // TODO: We should add implicit return only if there is no explicit return at the end
-            if (global_interpreter->current_function->body.count == 0 ||
-                global_interpreter->current_function->body
-                        .items[global_interpreter->current_function->body.count - 1] != OPCODE_RETURN) {
+            if (current_interpreter->current_function->body.count == 0 ||
+                current_interpreter->current_function->body
+                        .items[current_interpreter->current_function->body.count - 1] != OPCODE_RETURN) {
                 emit_constant_number(0);
                 emit_opcode(OPCODE_RETURN);
             }
 
             symbol *s = get_symbol_id(create_symbol(function_name, SYMBOL_FUNCTION));
-            s->as.funcdecl.body = global_interpreter->current_function;
-            s->as.funcdecl.args = global_interpreter->current_function->args.items;
-            s->as.funcdecl.arg_count = global_interpreter->current_function->args.count;
+            s->as.funcdecl = current_interpreter->current_function;
         }
 
-        global_interpreter->current_function = &global_interpreter->bytecode.items[0];
+        current_interpreter->current_function = &current_interpreter->bytecode.items[0];
         expect_kw(KW_END);
     } else {
         compile_expr();
@@ -813,11 +1546,11 @@ void compile_program() {
 }
 
 symbol *get_symbol(const char *name) {
-    for (int i = global_interpreter->symbols_table_count - 1; i >= 0; i--) {
-        symbol *s = &global_interpreter->symbols_table[i];
+    for (int i = current_interpreter->symbols_table_count - 1; i >= 0; i--) {
+        symbol *s = &current_interpreter->symbols_table[i];
         if (s && s->type != SYMBOL_NONE && strcmp(s->name, name) == 0) {
-            if (s->depth == 0 || s->depth == global_interpreter->depth) {
-                return &global_interpreter->symbols_table[i];
+            if (s->depth == 0 || s->depth == current_interpreter->depth) {
+                return &current_interpreter->symbols_table[i];
             }
         }
     }
@@ -826,123 +1559,583 @@ symbol *get_symbol(const char *name) {
 }
 
 symbol *get_symbol_id(size_t idx) {
-    return &global_interpreter->symbols_table[idx];
+    return &current_interpreter->symbols_table[idx];
 }
 
 size_t create_symbol(const char *name, symbol_type type) {
-    if (global_interpreter->symbols_table_count == MAX_SYMBOL_COUNT) {
+    if (current_interpreter->symbols_table_count == MAX_SYMBOL_COUNT) {
         ERR("No more space to allocate more symbols");
     }
-    symbol *s = &global_interpreter->symbols_table[global_interpreter->symbols_table_count];
+    symbol *s = &current_interpreter->symbols_table[current_interpreter->symbols_table_count];
     s->name = name;
     s->type = type;
-    s->depth = global_interpreter->depth;
-    return global_interpreter->symbols_table_count++;
+    s->depth = current_interpreter->depth;
+    return current_interpreter->symbols_table_count++;
 }
 
 size_t create_symbol_from_value(const char *name, value v) {
-    if (v.type == VAL_NUM) {
-        size_t s = create_symbol(name, SYMBOL_VARIABLE_INT);
-        get_symbol_id(s)->as.integer = v.as.number;
-        return s;
-    } else if (v.type == VAL_STRING) {
-        size_t s = create_symbol(name, SYMBOL_VARIABLE_STRING);
-        get_symbol_id(s)->as.string = v.as.string;
-        return s;
-    }
-    ERR("Unknown value type %d", v.type);
+    size_t s = create_symbol(name, SYMBOL_VARIABLE);
+    get_symbol_id(s)->as.value = v;
+    return s;
 }
 
 void prepare_funcall_args(symbol *function) {
-    for (size_t i = 0; i < function->as.funcdecl.arg_count; i++) {
-        create_symbol(function->as.funcdecl.args[i], SYMBOL_VARIABLE_INT);
+    for (size_t i = 0; i < function->as.funcdecl->args.count; i++) {
+        create_symbol_from_value(function->as.funcdecl->args.items[i], NUM_VAL(0));
     }
 }
 
-void print_val(value *v) {
-    if (v->type == VAL_STRING) {
-        interpreter_log("%s", v->as.string);
-    } else if (v->type == VAL_NUM) {
-        interpreter_log("%d", v->as.number);
+void print_val(value v) {
+    if (IS_STRING(v)) {
+        interpreter_write(string_cstr(AS_STRING(v)));
+    } else if (IS_NUM(v)) {
+        interpreter_log("%d", AS_NUM(v));
+    } else if (IS_FIXED(v)) {
+        char buffer[32];
+        fixed_to_str(AS_FIXED(v), buffer);
+        interpreter_log("%s", buffer);
+    } else if (IS_TABLE(v)) {
+        basic_table *t = AS_TABLE(v);
+        interpreter_log("table(%zu)", t->array.count + t->hash_count);
     } else {
-        ERR("Unknown value type %d\n", v->type);
+        ERR("Unknown value type %d\n", VALUE_TYPE(v));
     }
 }
 
-void internal_print_fn() {
-    for (size_t i = global_interpreter->sp; i < global_interpreter->stack.count; i++) {
-        value v = global_interpreter->stack.items[i];
-        print_val(&v);
+void internal_print_fn(int argc, const value *argv) {
+    for (int i = 0; i < argc; i++) {
+        print_val(argv[i]);
         interpreter_log(" ");
     }
-    global_interpreter->stack.count = global_interpreter->sp;
-    basic_push_int(0);
 }
 
-void printn_fn() {
-    internal_print_fn();
+value printn_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    internal_print_fn(argc, argv);
     interpreter_log("\n");
+    return BASIC_VOID;
 }
 
-void print_fn() {
-    internal_print_fn();
+value print_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    internal_print_fn(argc, argv);
+    return BASIC_VOID;
 }
 
-void exit_fn() {
-    longjmp(err_jmp, -1);
+value exit_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    (void)argv;
+    longjmp(current_interpreter->err_jmp, -1);
 }
 
-void sleep_fn() {
-    int v = basic_pop_value_num();
-    global_interpreter->wakeup_time = global_interpreter->time_elapsed + v;
-    global_interpreter->state = STATE_SLEEPING;
+value sleep_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    basic_sleep(ctx, IS_FIXED(argv[0]) ? AS_FIXED(argv[0]) / (float)FIXED_ONE : AS_NUM(argv[0]));
+    return BASIC_VOID;
 }
 
-void mod_fn() {
-    int mod = basic_pop_value_num();
-    int v = basic_pop_value_num();
-    basic_push_int(fmod(v, mod));
+value mod_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return NUM_VAL(fmod(AS_NUM(argv[0]), AS_NUM(argv[1])));
 }
 
-void length_fn() {
-    const char *s = basic_pop_value_string();
-    basic_push_int(strlen(s));
+value length_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return NUM_VAL(AS_STRING(argv[0])->length);
 }
 
-bool is_true(value v) {
-    if (v.type == VAL_NUM) {
-        return v.as.number != 0;
+value len_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    if (IS_TABLE(argv[0])) {
+        return NUM_VAL(AS_TABLE(argv[0])->array.count + AS_TABLE(argv[0])->hash_count);
+    } else if (IS_STRING(argv[0])) {
+        return NUM_VAL(AS_STRING(argv[0])->length);
     }
-    if (v.type == VAL_STRING) {
-        return strlen(v.as.string) != 0;
-    }
-    ERR("Unknown value type");
+    ERR("LEN expects a table or a string");
 }
 
-void breakpoint_fn() {
-    BREAKPOINT();
+// String natives return slices of their argument, characters are never copied.
+// Indices start at 0 like tables and out of range arguments are clamped.
+size_t clamp_index(int32_t index, size_t length) {
+    if (index < 0) {
+        return 0;
+    }
+    return (size_t)index > length ? length : (size_t)index;
 }
 
-void register_std_lib() {
-    // DEBUG
-    register_function("BP", breakpoint_fn, 0);
-    // IO
-    register_function("PRINTN", printn_fn, -1);
-    register_function("PRINT", print_fn, -1);
-    register_function("EXIT", exit_fn, 1);
-    register_function("SLEEP", sleep_fn, 1);
-    // MATHS
-    register_function("MOD", mod_fn, 2);
-    // STRINGS
-    register_function("LENGTH", length_fn, 1);
+value mid_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_string *s = AS_STRING(argv[0]);
+    size_t offset = clamp_index(AS_NUM(argv[1]), s->length);
+    size_t length = clamp_index(AS_NUM(argv[2]), s->length - offset);
+    return STRING_VAL(string_slice(s, offset, length));
 }
 
-void default_print(const char *text) {
-    printf("%s", text);
+value left_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_string *s = AS_STRING(argv[0]);
+    return STRING_VAL(string_slice(s, 0, clamp_index(AS_NUM(argv[1]), s->length)));
 }
 
-long long timeInMilliseconds(void) {
-    struct timeval tv;
+value right_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_string *s = AS_STRING(argv[0]);
+    size_t length = clamp_index(AS_NUM(argv[1]), s->length);
+    return STRING_VAL(string_slice(s, s->length - length, length));
+}
+
+// Index of the first occurrence of needle in s at or after start, or -1
+int32_t string_find(basic_string *s, basic_string *needle, size_t start) {
+    const char *chars = string_chars(s);
+    const char *needle_chars = string_chars(needle);
+    if (needle->length == 0) {
+        return start <= s->length ? (int32_t)start : -1;
+    }
+    while (start + needle->length <= s->length) {
+        const char *found = memchr(chars + start, needle_chars[0], s->length - needle->length - start + 1);
+        if (found == NULL) {
+            break;
+        }
+        start = found - chars;
+        if (memcmp(found, needle_chars, needle->length) == 0) {
+            return start;
+        }
+        start++;
+    }
+    return -1;
+}
+
+value find_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return NUM_VAL(string_find(AS_STRING(argv[0]), AS_STRING(argv[1]), 0));
+}
+
+value split_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_string *s = AS_STRING(argv[0]);
+    basic_string *separator = AS_STRING(argv[1]);
+    if (separator->length == 0) {
+        ERR("SPLIT expects a non empty separator");
+    }
+    basic_table *t = table_new(0);
+    size_t start = 0;
+    while (true) {
+        int32_t found = string_find(s, separator, start);
+        size_t end = found < 0 ? s->length : (size_t)found;
+        arena_append(interpreter_arena, &t->array, STRING_VAL(string_slice(s, start, end - start)));
+        if (found < 0) {
+            break;
+        }
+        start = end + separator->length;
+    }
+    return TABLE_VAL(t);
+}
+
+value trim_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_string *s = AS_STRING(argv[0]);
+    const char *chars = string_chars(s);
+    size_t start = 0;
+    size_t end = s->length;
+    while (start < end && isspace((unsigned char)chars[start])) {
+        start++;
+    }
+    while (end > start && isspace((unsigned char)chars[end - 1])) {
+        end--;
+    }
+    return STRING_VAL(string_slice(s, start, end - start));
+}
+
+// Bulk array operations. They work on the array part of a table, integers have
+// a zero tag so a run of integer values is just zero extended int32 words and
+// the kernels can process LANE_COUNT of them at once. Any block holding another
+// type goes through the scalar path with the usual arithmetic rules.
+typedef int64_t lanes __attribute__((vector_size(16)));
+#define LANE_COUNT (sizeof(lanes) / sizeof(int64_t))
+
+static inline lanes lanes_load(const value *items) {
+    lanes v;
+    memcpy(&v, items, sizeof(v));
+    return v;
+}
+
+static inline void lanes_store(value *items, lanes v) {
+    memcpy(items, &v, sizeof(v));
+}
+
+static inline bool lanes_all_int(lanes v) {
+    lanes tags = v >> 32;
+    for (size_t i = 0; i < LANE_COUNT; i++) {
+        if (tags[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline lanes lanes_sign_extend(lanes v) {
+    return (v << 32) >> 32;
+}
+
+static inline bool lanes_fit_int32(lanes v) {
+    lanes overflow = lanes_sign_extend(v) ^ v;
+    for (size_t i = 0; i < LANE_COUNT; i++) {
+        if (overflow[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline lanes lanes_to_values(lanes v) {
+    return v & 0xFFFFFFFF;
+}
+
+static inline lanes lanes_splat(value v) {
+    lanes result;
+    for (size_t i = 0; i < LANE_COUNT; i++) {
+        result[i] = v;
+    }
+    return result;
+}
+
+value array_item(value v, const char *fn) {
+    if (!IS_NUMERIC(v)) {
+        ERR("%s expects a table of numbers", fn);
+    }
+    return v;
+}
+
+value afill_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_table *t = AS_TABLE(argv[0]);
+    value v = argv[1];
+    int32_t count = AS_NUM(argv[2]);
+    if (count < 0) {
+        ERR("AFILL expects a positive count");
+    }
+    table_array_resize(t, count);
+
+    lanes fill = lanes_splat(v);
+    size_t i = 0;
+    for (; i + LANE_COUNT <= (size_t)count; i += LANE_COUNT) {
+        lanes_store(&t->array.items[i], fill);
+    }
+    for (; i < (size_t)count; i++) {
+        t->array.items[i] = v;
+    }
+    return TABLE_VAL(t);
+}
+
+value acopy_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_table *dst = AS_TABLE(argv[0]);
+    basic_table *src = AS_TABLE(argv[1]);
+    size_t count = src->array.count;
+    table_array_resize(dst, count);
+    memmove(dst->array.items, src->array.items, sizeof(*src->array.items) * count);
+    // A longer destination loses its tail, the hash part has no key below the old count
+    dst->array.count = count;
+    return TABLE_VAL(dst);
+}
+
+value asum_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    basic_table *t = AS_TABLE(argv[0]);
+    value *items = t->array.items;
+    size_t count = t->array.count;
+
+    lanes sums = {0};
+    int64_t int_sum = 0;
+    int64_t fixed_sum = 0;
+    bool has_fixed = false;
+    size_t i = 0;
+    for (; i + LANE_COUNT <= count; i += LANE_COUNT) {
+        lanes block = lanes_load(&items[i]);
+        if (lanes_all_int(block)) {
+            sums += lanes_sign_extend(block);
+        } else {
+            for (size_t j = i; j < i + LANE_COUNT; j++) {
+                value v = array_item(items[j], "ASUM");
+                has_fixed |= IS_FIXED(v);
+                fixed_sum += IS_FIXED(v) ? AS_FIXED(v) : 0;
+                int_sum += IS_NUM(v) ? AS_NUM(v) : 0;
+            }
+        }
+    }
+    for (; i < count; i++) {
+        value v = array_item(items[i], "ASUM");
+        has_fixed |= IS_FIXED(v);
+        fixed_sum += IS_FIXED(v) ? AS_FIXED(v) : 0;
+        int_sum += IS_NUM(v) ? AS_NUM(v) : 0;
+    }
+    for (size_t l = 0; l < LANE_COUNT; l++) {
+        int_sum += sums[l];
+    }
+
+    if (has_fixed) {
+        if (int_sum > INT32_MAX || int_sum < INT32_MIN) {
+            ERR("Fixed point overflow in ASUM");
+        }
+        return fixed_result(int_sum * FIXED_ONE + fixed_sum, "ASUM");
+    }
+    if (int_sum > INT32_MAX || int_sum < INT32_MIN) {
+        ERR("Integer overflow in ASUM");
+    }
+    return NUM_VAL(int_sum);
+}
+
+// Applies op in place, operand is either a number or a table of the same length
+value array_elementwise(const value *argv, const char *fn, bool multiply) {
+    basic_table *t = AS_TABLE(argv[0]);
+    value operand = argv[1];
+    value *items = t->array.items;
+    size_t count = t->array.count;
+
+    value *operands = NULL;
+    if (IS_TABLE(operand)) {
+        if (AS_TABLE(operand)->array.count != count) {
+            ERR("%s expects tables of the same length", fn);
+        }
+        operands = AS_TABLE(operand)->array.items;
+    } else if (!IS_NUMERIC(operand)) {
+        ERR("%s expects a number or a table", fn);
+    }
+
+    lanes scalar = lanes_splat(operand);
+    bool scalar_is_int = IS_NUM(operand);
+    size_t i = 0;
+    for (; i + LANE_COUNT <= count; i += LANE_COUNT) {
+        lanes a = lanes_load(&items[i]);
+        lanes b = operands ? lanes_load(&operands[i]) : scalar;
+        if (lanes_all_int(a) && (operands ? lanes_all_int(b) : scalar_is_int)) {
+            lanes result = multiply ? lanes_sign_extend(a) * lanes_sign_extend(b)
+                                    : lanes_sign_extend(a) + lanes_sign_extend(b);
+            if (lanes_fit_int32(result)) {
+                lanes_store(&items[i], lanes_to_values(result));
+                continue;
+            }
+        }
+        // Mixed types or an overflow, the scalar path reports the exact operands
+        for (size_t j = i; j < i + LANE_COUNT; j++) {
+            value b = operands ? operands[j] : operand;
+            value a = array_item(items[j], fn);
+            items[j] = multiply ? numeric_mul(a, array_item(b, fn)) : numeric_add(a, array_item(b, fn));
+        }
+    }
+    for (; i < count; i++) {
+        value b = operands ? operands[i] : operand;
+        value a = array_item(items[i], fn);
+        items[i] = multiply ? numeric_mul(a, array_item(b, fn)) : numeric_add(a, array_item(b, fn));
+    }
+    return TABLE_VAL(t);
+}
+
+value aadd_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return array_elementwise(argv, "AADD", false);
+}
+
+value amul_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return array_elementwise(argv, "AMUL", true);
+}
+
+value array_extremum(const value *argv, const char *fn, bool maximum) {
+    basic_table *t = AS_TABLE(argv[0]);
+    value *items = t->array.items;
+    size_t count = t->array.count;
+    if (count == 0) {
+        ERR("%s of an empty table", fn);
+    }
+
+    value best = array_item(items[0], fn);
+    size_t i = 0;
+    if (count >= LANE_COUNT && lanes_all_int(lanes_load(items))) {
+        lanes bests = lanes_sign_extend(lanes_load(items));
+        for (; i + LANE_COUNT <= count; i += LANE_COUNT) {
+            lanes block = lanes_load(&items[i]);
+            if (!lanes_all_int(block)) {
+                break;
+            }
+            block = lanes_sign_extend(block);
+            lanes take = maximum ? block > bests : block < bests;
+            bests = (block & take) | (bests & ~take);
+        }
+        for (size_t l = 0; l < LANE_COUNT; l++) {
+            value v = NUM_VAL(bests[l]);
+            int order = compare_numbers(v, best);
+            if (maximum ? order > 0 : order < 0) {
+                best = v;
+            }
+        }
+    }
+    for (; i < count; i++) {
+        value v = array_item(items[i], fn);
+        int order = compare_numbers(v, best);
+        if (maximum ? order > 0 : order < 0) {
+            best = v;
+        }
+    }
+    return best;
+}
+
+value amin_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return array_extremum(argv, "AMIN", false);
+}
+
+value amax_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    return array_extremum(argv, "AMAX", true);
+}
+
+value gc_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    ctx->gc.major_requested = true;
+    return BASIC_VOID;
+}
+
+value gcstats_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    basic_gc_stats stats = ctx->gc.stats;
+    basic_table *t = table_new(0);
+    table_set(t, STRING_VAL(string_wrap("minor")), NUM_VAL(stats.minor_collections));
+    table_set(t, STRING_VAL(string_wrap("major")), NUM_VAL(stats.major_collections));
+    table_set(t, STRING_VAL(string_wrap("freed")), NUM_VAL(stats.objects_freed));
+    table_set(t, STRING_VAL(string_wrap("pause_us")), NUM_VAL(stats.total_pause_ns / 1000));
+    table_set(t, STRING_VAL(string_wrap("max_pause_us")), NUM_VAL(stats.max_pause_ns / 1000));
+    return TABLE_VAL(t);
+}
+
+// The counters are only there when the interpreter is built with ARENA_STATS
+value memstats_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    arena_stats stats = basic_get_memory_stats(ctx);
+    basic_table *t = table_new(0);
+    table_set(t, STRING_VAL(string_wrap("used")), NUM_VAL(stats.used));
+    table_set(t, STRING_VAL(string_wrap("committed")), NUM_VAL(stats.committed));
+    table_set(t, STRING_VAL(string_wrap("limit")), NUM_VAL(stats.limit));
+    table_set(t, STRING_VAL(string_wrap("free_blocks")), NUM_VAL(stats.free_blocks));
+    table_set(t, STRING_VAL(string_wrap("largest_free")), NUM_VAL(stats.largest_free));
+    table_set(t, STRING_VAL(string_wrap("fragmentation")), NUM_VAL(stats.fragmentation));
+    if (stats.has_counters) {
+        table_set(t, STRING_VAL(string_wrap("allocs")), NUM_VAL(stats.counters.allocs));
+        table_set(t, STRING_VAL(string_wrap("frees")), NUM_VAL(stats.counters.frees));
+        table_set(t, STRING_VAL(string_wrap("peak")), NUM_VAL(stats.counters.peak));
+    }
+    return TABLE_VAL(t);
+}
+
+value fix_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    value v = argv[0];
+    if (IS_FIXED(v)) {
+        return v;
+    }
+    if (AS_NUM(v) > (INT32_MAX >> FIXED_SHIFT) || AS_NUM(v) < (INT32_MIN >> FIXED_SHIFT)) {
+        ERR("%d is out of the fixed point range", AS_NUM(v));
+    }
+    return FIXED_VAL(AS_NUM(v) * FIXED_ONE);
+}
+
+value int_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    value v = argv[0];
+    if (IS_NUM(v)) {
+        return v;
+    }
+    // Truncate toward zero like integer division does
+    return NUM_VAL(AS_FIXED(v) / FIXED_ONE);
+}
+
+bool is_true(value v) {
+    if (IS_NUM(v)) {
+        return AS_NUM(v) != 0;
+    }
+    if (IS_FIXED(v)) {
+        return AS_FIXED(v) != 0;
+    }
+    if (IS_TABLE(v)) {
+        return true;
+    }
+    if (IS_STRING(v)) {
+        return AS_STRING(v)->length != 0;
+    }
+    ERR("Unknown value type");
+}
+
+value breakpoint_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)ctx;
+    (void)argc;
+    (void)argv;
+    BREAKPOINT();
+    return BASIC_VOID;
+}
+
+void register_std_lib(basic_ctx *ctx) {
+    // DEBUG
+    register_function(ctx, "BP", breakpoint_fn, "");
+    register_function(ctx, "GC", gc_fn, "");
+    register_function(ctx, "GCSTATS", gcstats_fn, ":t");
+    register_function(ctx, "MEMSTATS", memstats_fn, ":t");
+    // IO
+    register_function(ctx, "PRINTN", printn_fn, "v*");
+    register_function(ctx, "PRINT", print_fn, "v*");
+    register_function(ctx, "EXIT", exit_fn, "v");
+    register_function(ctx, "SLEEP", sleep_fn, "n");
+    // MATHS
+    register_function(ctx, "MOD", mod_fn, "ii:i");
+    register_function(ctx, "FIX", fix_fn, "n:f");
+    register_function(ctx, "INT", int_fn, "n:i");
+    // STRINGS
+    register_function(ctx, "LENGTH", length_fn, "s:i");
+    register_function(ctx, "MID", mid_fn, "sii:s");
+    register_function(ctx, "LEFT", left_fn, "si:s");
+    register_function(ctx, "RIGHT", right_fn, "si:s");
+    register_function(ctx, "FIND", find_fn, "ss:i");
+    register_function(ctx, "SPLIT", split_fn, "ss:t");
+    register_function(ctx, "TRIM", trim_fn, "s:s");
+    // TABLES
+    register_function(ctx, "LEN", len_fn, "v:i");
+    register_function(ctx, "AFILL", afill_fn, "tvi:t");
+    register_function(ctx, "ACOPY", acopy_fn, "tt:t");
+    register_function(ctx, "ASUM", asum_fn, "t:n");
+    register_function(ctx, "AADD", aadd_fn, "tv:t");
+    register_function(ctx, "AMUL", amul_fn, "tv:t");
+    register_function(ctx, "AMIN", amin_fn, "t:n");
+    register_function(ctx, "AMAX", amax_fn, "t:n");
+}
+
+void default_print(basic_ctx *ctx, const char *text) {
+    (void)ctx;
+    printf("%s", text);
+}
+
+long long timeInMilliseconds(void) {
+    struct timeval tv;
 
     gettimeofday(&tv, NULL);
     return (((long long)tv.tv_sec) * 1000) + (tv.tv_usec / 1000);
@@ -950,136 +2143,503 @@ long long timeInMilliseconds(void) {
 
 // Externals
 
-bool interpreter_init(const char *src, void (*print_fn)(const char *), void (*arena_append_fn)(const char *)) {
-    interpreter_arena = arena_default();
-    global_interpreter = arena_alloc(interpreter_arena, sizeof(*global_interpreter));
-    memset(global_interpreter, 0, sizeof(*global_interpreter));
-    global_interpreter->print_fn = print_fn == NULL ? default_print : print_fn;
-    global_interpreter->append_print_fn = arena_append_fn == NULL ? default_print : arena_append_fn;
-    parser_reader = 0;
-    token_count = 0;
+// Running out of memory stops the program like any runtime error
+void basic_out_of_memory(arena *a, size_t size) {
+    ERR("Out of memory, %zu bytes requested past the %zu bytes limit", size, a->limit);
+}
+
+arena *basic_arena_new() {
+    arena *a = arena_default();
+    a->on_exhausted = basic_out_of_memory;
+    return a;
+}
+
+// Natives have to be registered between interpreter_init and interpreter_load
+// as calls are bound to them when the program is compiled. Each context owns its
+// arenas, everything it allocates goes away with interpreter_destroy.
+basic_ctx *interpreter_init(void (*print_fn)(basic_ctx *, const char *),
+                            void (*arena_append_fn)(basic_ctx *, const char *), void *user_data) {
+    arena *code = basic_arena_new();
+    basic_ctx *ctx = arena_alloc(code, sizeof(*ctx));
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->code_arena = code;
+    ctx->arena = basic_arena_new();
+    ctx->compile_arena = basic_arena_new();
+    ctx->scratch = basic_arena_new();
+    ctx->print_fn = print_fn == NULL ? default_print : print_fn;
+    ctx->append_print_fn = arena_append_fn == NULL ? default_print : arena_append_fn;
+    ctx->user_data = user_data;
+    current_interpreter = ctx;
+    register_std_lib(ctx);
+    return ctx;
+}
+
+void basic_set_memory_limit(basic_ctx *ctx, size_t bytes) {
+    arena_set_limit(ctx->arena, bytes);
+}
+
+// On failure the error is printed and the context destroyed
+bool interpreter_load(basic_ctx *ctx, const char *src) {
+    current_interpreter = ctx;
     // TODO: Should not exit on first error
     volatile int error_code = 0;
-    if ((error_code = setjmp(err_jmp)) != 0) {
+    if ((error_code = setjmp(ctx->err_jmp)) != 0) {
         if (error_code != -1) {
-            interpreter_log("\nexit from error from line %d\n", error_line);
+            interpreter_log("\nexit from error from line %d\n", ctx->error_line);
         }
-        interpreter_destroy();
+        interpreter_destroy(ctx);
         return false;
     }
-    register_std_lib();
     lexical_analysis(src);
 
     function_code main = {.name = "main"};
-    arena_append(&global_interpreter->bytecode, main);
-    global_interpreter->current_function = &global_interpreter->bytecode.items[0];
+    arena_append(interpreter_code_arena, &current_interpreter->bytecode, main);
+    current_interpreter->current_function = &current_interpreter->bytecode.items[0];
 
     if (!peek_type(TOKEN_EOF)) {
         compile_program();
     }
     expect(TOKEN_EOF);
     emit_opcode(OPCODE_EOF);
-    global_interpreter->state = STATE_RUNNING;
+    // Names are copied out of the tokens, they are not needed past this point
+    arena_free(ctx->compile_arena);
+    ctx->compile_arena = NULL;
+    ctx->parser.tokens.items = NULL;
+    ctx->parser.tokens.count = ctx->parser.tokens.capacity = 0;
+    ctx->state = STATE_RUNNING;
+    ctx->gc.next_minor = ctx->arena->used + GC_NURSERY_BYTES;
+    ctx->gc.next_major = ctx->arena->used + GC_MIN_MAJOR_BYTES;
     return true;
 }
 
-void advance_interpreter_time(float time) {
-    global_interpreter->time_elapsed += time;
+void advance_interpreter_time(basic_ctx *ctx, float time) {
+    ctx->time_elapsed += time;
+    if (ctx->state == STATE_SLEEPING && ctx->time_elapsed >= ctx->wakeup_time) {
+        ctx->state = STATE_RUNNING;
+    }
+}
+
+int64_t numeric_as_fixed(value v) {
+    if (IS_FIXED(v)) {
+        return AS_FIXED(v);
+    }
+    if (IS_NUM(v)) {
+        return (int64_t)AS_NUM(v) * FIXED_ONE;
+    }
+    ERR("Expected numeric value on top of stack");
+}
+
+value fixed_result(int64_t fixed, const char *op) {
+    if (fixed < INT32_MIN || fixed > INT32_MAX) {
+        ERR("Fixed point overflow in %s", op);
+    }
+    return FIXED_VAL(fixed);
+}
+
+value numeric_add(value a, value b) {
+    if (IS_NUM(a) && IS_NUM(b)) {
+        int32_t result;
+        if (__builtin_add_overflow(AS_NUM(a), AS_NUM(b), &result)) {
+            ERR("Integer overflow in %d + %d", AS_NUM(a), AS_NUM(b));
+        }
+        return NUM_VAL(result);
+    }
+    return fixed_result(numeric_as_fixed(a) + numeric_as_fixed(b), "+");
+}
+
+value numeric_mul(value a, value b) {
+    if (IS_NUM(a) && IS_NUM(b)) {
+        int32_t result;
+        if (__builtin_mul_overflow(AS_NUM(a), AS_NUM(b), &result)) {
+            ERR("Integer overflow in %d * %d", AS_NUM(a), AS_NUM(b));
+        }
+        return NUM_VAL(result);
+    } else if (IS_FIXED(a) && IS_FIXED(b)) {
+        // Widen, multiply and shift back in one go instead of a separate division
+        return fixed_result(((int64_t)AS_FIXED(a) * AS_FIXED(b)) >> FIXED_SHIFT, "*");
+    } else if (IS_FIXED(a) && IS_NUM(b)) {
+        return fixed_result((int64_t)AS_FIXED(a) * AS_NUM(b), "*");
+    } else if (IS_NUM(a) && IS_FIXED(b)) {
+        return fixed_result((int64_t)AS_NUM(a) * AS_FIXED(b), "*");
+    }
+    ERR("Expected numeric value on top of stack");
+}
+
+// Returns <0, 0 or >0 like strcmp, integers are promoted when compared to fixed point
+int compare_numbers(value a, value b) {
+    if (IS_NUM(a) && IS_NUM(b)) {
+        return (AS_NUM(a) > AS_NUM(b)) - (AS_NUM(a) < AS_NUM(b));
+    }
+    int64_t fa = numeric_as_fixed(a);
+    int64_t fb = numeric_as_fixed(b);
+    return (fa > fb) - (fa < fb);
+}
+
+// Values of different types are never equal, tables are compared by identity
+bool values_equal(value a, value b) {
+    if (IS_NUMERIC(a) && IS_NUMERIC(b)) {
+        return compare_numbers(a, b) == 0;
+    }
+    if (IS_STRING(a) && IS_STRING(b)) {
+        return strings_equal(AS_STRING(a), AS_STRING(b));
+    }
+    return a == b;
+}
+
+// Strings are ordered byte by byte, numbers by value, anything else can't be ordered
+int compare_values(value a, value b) {
+    if (IS_STRING(a) && IS_STRING(b)) {
+        return strings_compare(AS_STRING(a), AS_STRING(b));
+    }
+    if (!IS_NUMERIC(a) || !IS_NUMERIC(b)) {
+        ERR("Can only compare two numbers or two strings");
+    }
+    return compare_numbers(a, b);
+}
+
+void value_to_str(value v, char *result) {
+    if (IS_NUM(v)) {
+        int_to_str(AS_NUM(v), result);
+    } else if (IS_FIXED(v)) {
+        fixed_to_str(AS_FIXED(v), result);
+    } else if (IS_TABLE(v)) {
+        strcpy(result, "table");
+    } else {
+        basic_string *s = AS_STRING(v);
+        size_t length = s->length < 254 ? s->length : 254;
+        memcpy(result, string_chars(s), length);
+        result[length] = '\0';
+    }
+}
+
+uint64_t hash_value(value key) {
+    if (IS_STRING(key)) {
+        return string_hash(AS_STRING(key));
+    }
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+}
+
+bool keys_equal(value a, value b) {
+    if (a == b) {
+        return true;
+    }
+    return IS_STRING(a) && IS_STRING(b) && strings_equal(AS_STRING(a), AS_STRING(b));
+}
+
+basic_table *table_new(size_t array_capacity) {
+    basic_table *t = gc_alloc(GC_TABLE, sizeof(*t));
+    if (array_capacity > 0) {
+        t->array.capacity = array_capacity;
+        t->array.items = arena_alloc(interpreter_arena, sizeof(*t->array.items) * array_capacity);
+    }
+    return t;
+}
+
+// Returns the slot holding key, or the empty slot where it would be inserted
+table_entry *table_find_slot(basic_table *t, value key) {
+    size_t mask = t->hash_capacity - 1;
+    size_t i = hash_value(key) & mask;
+    while (t->entries[i].key != TABLE_EMPTY_KEY && !keys_equal(t->entries[i].key, key)) {
+        i = (i + 1) & mask;
+    }
+    return &t->entries[i];
+}
+
+void table_hash_grow(basic_table *t) {
+    table_entry *old_entries = t->entries;
+    size_t old_capacity = t->hash_capacity;
+
+    t->hash_capacity = old_capacity == 0 ? 8 : old_capacity * 2;
+    t->entries = arena_alloc(interpreter_arena, sizeof(*t->entries) * t->hash_capacity);
+    for (size_t i = 0; i < t->hash_capacity; i++) {
+        t->entries[i].key = TABLE_EMPTY_KEY;
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].key != TABLE_EMPTY_KEY) {
+            *table_find_slot(t, old_entries[i].key) = old_entries[i];
+        }
+    }
+    arena_free_node(interpreter_arena, old_entries);
+}
+
+// Backward shift deletion, keeps probe sequences intact without tombstones
+void table_hash_remove(basic_table *t, table_entry *slot) {
+    size_t mask = t->hash_capacity - 1;
+    size_t hole = slot - t->entries;
+    size_t i = hole;
+    while (true) {
+        i = (i + 1) & mask;
+        if (t->entries[i].key == TABLE_EMPTY_KEY) {
+            break;
+        }
+        size_t home = hash_value(t->entries[i].key) & mask;
+        bool can_move = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (can_move) {
+            t->entries[hole] = t->entries[i];
+            hole = i;
+        }
+    }
+    t->entries[hole].key = TABLE_EMPTY_KEY;
+    t->hash_count--;
+}
+
+// Keys stored while they were sparse may now continue the array part
+void table_migrate_hash(basic_table *t) {
+    while (t->hash_count > 0) {
+        table_entry *entry = table_find_slot(t, NUM_VAL(t->array.count));
+        if (entry->key == TABLE_EMPTY_KEY) {
+            break;
+        }
+        arena_append(interpreter_arena, &t->array, entry->value);
+        table_hash_remove(t, entry);
+    }
+}
+
+// Grows the array part to count entries, new entries are left for the caller to fill
+void table_array_resize(basic_table *t, size_t count) {
+    gc_write_barrier(&t->gc);
+    if (count <= t->array.count) {
+        return;
+    }
+    if (count > t->array.capacity) {
+        t->array.capacity = count;
+        t->array.items = arena_realloc(interpreter_arena, t->array.items, sizeof(*t->array.items) * count);
+    }
+    for (size_t i = t->array.count; i < count && t->hash_count > 0; i++) {
+        table_entry *entry = table_find_slot(t, NUM_VAL(i));
+        if (entry->key != TABLE_EMPTY_KEY) {
+            table_hash_remove(t, entry);
+        }
+    }
+    t->array.count = count;
+    table_migrate_hash(t);
+}
+
+bool table_get(basic_table *t, value key, value *result) {
+    if (IS_NUM(key) && AS_NUM(key) >= 0 && (size_t)AS_NUM(key) < t->array.count) {
+        *result = t->array.items[AS_NUM(key)];
+        return true;
+    }
+    if (t->hash_count == 0) {
+        return false;
+    }
+    table_entry *entry = table_find_slot(t, key);
+    if (entry->key == TABLE_EMPTY_KEY) {
+        return false;
+    }
+    *result = entry->value;
+    return true;
+}
+
+void table_set(basic_table *t, value key, value v) {
+    if (!IS_NUM(key) && !IS_STRING(key)) {
+        ERR("Table keys must be integers or strings");
+    }
+    // A single entry changes, tracing the whole table at every minor collection
+    // would make filling a big one quadratic
+    gc_write_barrier_value(&t->gc, key);
+    gc_write_barrier_value(&t->gc, v);
+    if (IS_NUM(key) && AS_NUM(key) >= 0) {
+        size_t index = AS_NUM(key);
+        if (index < t->array.count) {
+            t->array.items[index] = v;
+            return;
+        }
+        if (index == t->array.count) {
+            arena_append(interpreter_arena, &t->array, v);
+            table_migrate_hash(t);
+            return;
+        }
+    }
+
+    // Keep the load factor under 3/4
+    if ((t->hash_count + 1) * 4 > t->hash_capacity * 3) {
+        table_hash_grow(t);
+    }
+    table_entry *entry = table_find_slot(t, key);
+    if (entry->key == TABLE_EMPTY_KEY) {
+        entry->key = key;
+        t->hash_count++;
+    }
+    entry->value = v;
+}
+
+// The cursor walks the array part first and then the hash slots
+bool table_next(basic_table *t, size_t *cursor, value *key, value *v) {
+    size_t c = *cursor;
+    if (c < t->array.count) {
+        *key = NUM_VAL(c);
+        *v = t->array.items[c];
+        *cursor = c + 1;
+        return true;
+    }
+    for (size_t slot = c - t->array.count; slot < t->hash_capacity; slot++) {
+        if (t->entries[slot].key != TABLE_EMPTY_KEY) {
+            *key = t->entries[slot].key;
+            *v = t->entries[slot].value;
+            *cursor = t->array.count + slot + 1;
+            return true;
+        }
+    }
+    return false;
 }
 
 bool step_bytecode() {
-    opcode_type op = global_interpreter->current_function->body.items[global_interpreter->ip++];
+    opcode_type op = current_interpreter->current_function->body.items[current_interpreter->ip++];
     switch (op) {
         case OPCODE_CONSTANT_STRING: {
             uint16_t index = read_word();
-            value value = global_interpreter->values.items[index];
-            arena_append(&global_interpreter->stack, value);
+            value value = current_interpreter->values.items[index];
+            arena_append(interpreter_arena, &current_interpreter->stack, value);
             return true;
         } break;
         case OPCODE_CONSTANT_NUMBER: {
-            uint16_t v = read_word();
-            value res = {.type = VAL_NUM, .as.number = v};
-            arena_append(&global_interpreter->stack, res);
+            int16_t v = read_word();
+            arena_append(interpreter_arena, &current_interpreter->stack, NUM_VAL(v));
+            return true;
+        } break;
+        case OPCODE_CONSTANT_NUMBER_WIDE: {
+            int32_t v = read_dword();
+            arena_append(interpreter_arena, &current_interpreter->stack, NUM_VAL(v));
+            return true;
+        } break;
+        case OPCODE_CONSTANT_FIXED: {
+            int32_t v = read_dword();
+            arena_append(interpreter_arena, &current_interpreter->stack, FIXED_VAL(v));
             return true;
         } break;
         case OPCODE_EOF:
             return false;
         case OPCODE_ADD: {
-            value b = pop(&global_interpreter->stack);
-            value a = pop(&global_interpreter->stack);
-            if (a.type == VAL_NUM && b.type == VAL_NUM) {
-                basic_push_int(a.as.number + b.as.number);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            if (IS_NUMERIC(a) && IS_NUMERIC(b)) {
+                basic_push_value(numeric_add(a, b));
             } else {
-                char s1[255] = {0};
-                char s2[255] = {0};
-                if (a.type == VAL_NUM) {
-                    int_to_str(a.as.number, s1);
+                // Only strings can be long, everything else fits in a small buffer
+                char s1[32] = {0};
+                char s2[32] = {0};
+                const char *right = s2;
+                size_t right_length;
+                if (IS_STRING(b)) {
+                    right = string_chars(AS_STRING(b));
+                    right_length = AS_STRING(b)->length;
                 } else {
-                    strncpy(s1, a.as.string, sizeof(s1));
+                    value_to_str(b, s2);
+                    right_length = strlen(s2);
                 }
-                if (b.type == VAL_NUM) {
-                    int_to_str(b.as.number, s2);
+                basic_string *left;
+                if (IS_STRING(a)) {
+                    left = string_append(AS_STRING(a), right, right_length);
                 } else {
-                    strncpy(s2, b.as.string, sizeof(s2));
+                    // Both halves are joined in the scratch arena so the result is allocated once
+                    value_to_str(a, s1);
+                    size_t left_length = strlen(s1);
+                    arena_clear(interpreter_scratch);
+                    char *chars = arena_alloc(interpreter_scratch, left_length + right_length);
+                    memcpy(chars, s1, left_length);
+                    memcpy(chars + left_length, right, right_length);
+                    left = string_append(string_wrap(""), chars, left_length + right_length);
                 }
-                char *result = arena_alloc(interpreter_arena, strlen(s1) + strlen(s2) + 1);
-                result[0] = '\0';
-                strcat(result, s1);
-                strcat(result, s2);
-                basic_push_string(result);
+                basic_push_value(STRING_VAL(left));
             }
             return true;
         }
         case OPCODE_MULT: {
-            basic_push_int(basic_pop_value_num() * basic_pop_value_num());
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_value(numeric_mul(a, b));
             return true;
         }
         case OPCODE_SUB: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a - b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            if (IS_NUM(a) && IS_NUM(b)) {
+                int32_t result;
+                if (__builtin_sub_overflow(AS_NUM(a), AS_NUM(b), &result)) {
+                    ERR("Integer overflow in %d - %d", AS_NUM(a), AS_NUM(b));
+                }
+                basic_push_int(result);
+            } else {
+                basic_push_value(fixed_result(numeric_as_fixed(a) - numeric_as_fixed(b), "-"));
+            }
             return true;
         }
         case OPCODE_DIV: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a / b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            if (IS_NUM(a) && IS_NUM(b)) {
+                if (AS_NUM(b) == 0) {
+                    ERR("Division by zero");
+                }
+                if (AS_NUM(a) == INT32_MIN && AS_NUM(b) == -1) {
+                    ERR("Integer overflow in %d / %d", AS_NUM(a), AS_NUM(b));
+                }
+                basic_push_int(AS_NUM(a) / AS_NUM(b));
+            } else if (IS_FIXED(a) && IS_NUM(b)) {
+                if (AS_NUM(b) == 0) {
+                    ERR("Division by zero");
+                }
+                basic_push_value(fixed_result((int64_t)AS_FIXED(a) / AS_NUM(b), "/"));
+            } else {
+                int64_t fa = numeric_as_fixed(a);
+                int64_t fb = numeric_as_fixed(b);
+                if (fb == 0) {
+                    ERR("Division by zero");
+                }
+                basic_push_value(fixed_result(fa * FIXED_ONE / fb, "/"));
+            }
             return true;
         }
         case OPCODE_EQEQ: {
-            basic_push_int(basic_pop_value_num() == basic_pop_value_num());
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(values_equal(a, b));
             return true;
         }
         case OPCODE_NEQ: {
-            basic_push_int(basic_pop_value_num() != basic_pop_value_num());
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(!values_equal(a, b));
             return true;
         }
         case OPCODE_LT: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a < b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(compare_values(a, b) < 0);
             return true;
         }
         case OPCODE_LTE: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a <= b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(compare_values(a, b) <= 0);
             return true;
         }
         case OPCODE_GT: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a > b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(compare_values(a, b) > 0);
             return true;
         }
         case OPCODE_GTE: {
-            int b = basic_pop_value_num();
-            int a = basic_pop_value_num();
-            basic_push_int(a >= b);
+            value b = pop(&current_interpreter->stack);
+            value a = pop(&current_interpreter->stack);
+            basic_push_int(compare_values(a, b) >= 0);
             return true;
         }
         case OPCODE_NEGATE: {
-            basic_push_int(-basic_pop_value_num());
+            value v = pop(&current_interpreter->stack);
+            if (IS_FIXED(v)) {
+                basic_push_value(fixed_result(-(int64_t)AS_FIXED(v), "-"));
+            } else if (IS_NUM(v)) {
+                if (AS_NUM(v) == INT32_MIN) {
+                    ERR("Integer overflow in -(%d)", AS_NUM(v));
+                }
+                basic_push_int(-AS_NUM(v));
+            } else {
+                ERR("Expected numeric value on top of stack");
+            }
             return true;
         } break;
         case OPCODE_FUNCALL: {
@@ -1088,50 +2648,59 @@ bool step_bytecode() {
             if (function == NULL) {
                 ERR("Unknown symbol %s", function_name);
             }
-            if (function->type == SYMBOL_FUNCTION_NATIVE) {
-                uint16_t funcall_arg_count = read_word();
-                size_t expected = function->as.native_func.arg_count;
-                if (funcall_arg_count != expected && function->as.native_func.variadic_arg_count == false) {
-                    ERR("Function %s expected %zu args but recieved %zu", function_name, expected, funcall_arg_count);
-                }
-                function->as.native_func.function();
-            } else if (function->type == SYMBOL_FUNCTION) {
+            if (function->type == SYMBOL_FUNCTION) {
                 uint16_t funcall_arg_count = read_word();
-                size_t expected = function->as.funcdecl.arg_count;
+                size_t expected = function->as.funcdecl->args.count;
                 if (funcall_arg_count != expected) {
                     ERR("Function %s expected %zu args but recieved %zu", function_name, expected, funcall_arg_count);
                 }
-                global_interpreter->depth++;
-                size_t previous_symbol_count = global_interpreter->symbols_table_count;
+                current_interpreter->depth++;
+                size_t previous_symbol_count = current_interpreter->symbols_table_count;
                 for (int i = expected - 1; i >= 0; i--) {
-                    create_symbol_from_value(function->as.funcdecl.args[i], pop(&global_interpreter->stack));
+                    create_symbol_from_value(function->as.funcdecl->args.items[i], pop(&current_interpreter->stack));
                 }
-                return_frame frame = {global_interpreter->current_function, global_interpreter->ip,
-                                      global_interpreter->sp, previous_symbol_count};
-                arena_append(&global_interpreter->return_stack, frame);
-                global_interpreter->current_function = function->as.funcdecl.body;
-                global_interpreter->ip = 0;
-                global_interpreter->sp = global_interpreter->stack.count;
+                return_frame frame = {current_interpreter->current_function, current_interpreter->ip,
+                                      current_interpreter->sp, previous_symbol_count};
+                arena_append(interpreter_arena, &current_interpreter->return_stack, frame);
+                current_interpreter->current_function = function->as.funcdecl;
+                current_interpreter->ip = 0;
+                current_interpreter->sp = current_interpreter->stack.count;
             } else {
                 ERR("%s is not a function", function->name);
             }
             return true;
         } break;
+        case OPCODE_CALL_NATIVE: {
+            native_function *native = &current_interpreter->natives.items[read_word()];
+            uint16_t argc = read_word();
+            value *argv = &current_interpreter->stack.items[current_interpreter->stack.count - argc];
+            for (size_t i = 0; i < argc; i++) {
+                if (!(native_arg_types(native, i) & (1 << VALUE_TYPE(argv[i])))) {
+                    ERR("Function %s does not accept a %s as argument %zu", native->name,
+                        value_type_names[VALUE_TYPE(argv[i])], i + 1);
+                }
+            }
+            value result = native->function(current_interpreter, argc, argv);
+            // Arguments are still on the stack so it can't move, the result takes the first slot
+            current_interpreter->stack.count -= argc;
+            if (native->returns) {
+                basic_push_value(result);
+            }
+            if (current_interpreter->state == STATE_WAITING) {
+                current_interpreter->resume_has_result = native->returns;
+            }
+            return true;
+        } break;
         case OPCODE_ASSIGN: {
             const char *variable_name = basic_pop_value_string();
-            value v = pop(&global_interpreter->stack);
+            value v = pop(&current_interpreter->stack);
 
             symbol *s = get_symbol(variable_name);
             if (s == NULL) {
                 create_symbol_from_value(variable_name, v);
             } else {
-                if (v.type == VAL_NUM) {
-                    s->type = SYMBOL_VARIABLE_INT;
-                    s->as.integer = v.as.number;
-                } else if (v.type == VAL_STRING) {
-                    s->type = SYMBOL_VARIABLE_STRING;
-                    s->as.string = v.as.string;
-                }
+                s->type = SYMBOL_VARIABLE;
+                s->as.value = v;
             }
             return true;
         } break;
@@ -1141,41 +2710,93 @@ bool step_bytecode() {
             if (!s) {
                 ERR("Unknown variable %s", variable_name);
             }
-            if (s->type == SYMBOL_VARIABLE_INT) {
-                basic_push_int(s->as.integer);
-            } else if (s->type == SYMBOL_VARIABLE_STRING) {
-                basic_push_string(s->as.string);
+            if (s->type == SYMBOL_VARIABLE) {
+                arena_append(interpreter_arena, &current_interpreter->stack, s->as.value);
             }
             return true;
             break;
         case OPCODE_JUMP_IF_FALSE: {
-            value result = pop(&global_interpreter->stack);
+            value result = pop(&current_interpreter->stack);
             uint16_t offset = read_word();
             if (!is_true(result)) {
-                global_interpreter->ip += (int16_t)offset;
+                current_interpreter->ip += (int16_t)offset;
             }
-            opcode_type next = global_interpreter->current_function->body.items[global_interpreter->ip];
+            opcode_type next = current_interpreter->current_function->body.items[current_interpreter->ip];
             if (next == OPCODE_JUMP_IF_FALSE) {
                 basic_push_int(is_true(result));
             }
             return true;
         } break;
+        case OPCODE_TABLE_NEW: {
+            uint16_t item_count = read_word();
+            basic_table *t = table_new(item_count);
+            if (item_count > 0) {
+                value *items = &current_interpreter->stack.items[current_interpreter->stack.count - item_count];
+                memcpy(t->array.items, items, sizeof(*items) * item_count);
+            }
+            t->array.count = item_count;
+            current_interpreter->stack.count -= item_count;
+            basic_push_value(TABLE_VAL(t));
+            return true;
+        } break;
+        case OPCODE_INDEX_LOAD: {
+            value key = pop(&current_interpreter->stack);
+            value t = pop(&current_interpreter->stack);
+            if (!IS_TABLE(t)) {
+                ERR("Trying to index a value that is not a table");
+            }
+            value result;
+            if (!table_get(AS_TABLE(t), key, &result)) {
+                char key_str[255] = {0};
+                value_to_str(key, key_str);
+                ERR("Key %s not found in table", key_str);
+            }
+            basic_push_value(result);
+            return true;
+        } break;
+        case OPCODE_INDEX_STORE: {
+            value v = pop(&current_interpreter->stack);
+            value key = pop(&current_interpreter->stack);
+            value t = pop(&current_interpreter->stack);
+            if (!IS_TABLE(t)) {
+                ERR("Trying to index a value that is not a table");
+            }
+            table_set(AS_TABLE(t), key, v);
+            return true;
+        } break;
+        case OPCODE_TABLE_NEXT: {
+            size_t cursor = basic_pop_value_num();
+            value t = pop(&current_interpreter->stack);
+            uint16_t offset = read_word();
+            if (!IS_TABLE(t)) {
+                ERR("FOR ... IN expects a table or a range");
+            }
+            value key, v;
+            if (table_next(AS_TABLE(t), &cursor, &key, &v)) {
+                basic_push_int(cursor);
+                basic_push_value(key);
+                basic_push_value(v);
+            } else {
+                current_interpreter->ip += (int16_t)offset;
+            }
+            return true;
+        } break;
         case OPCODE_JUMP: {
             uint16_t offset = read_word();
-            global_interpreter->ip += (int16_t)offset;
+            current_interpreter->ip += (int16_t)offset;
             return true;
         } break;
         case OPCODE_DISCARD: {
-            (void)pop(&global_interpreter->stack);
+            (void)pop(&current_interpreter->stack);
             return true;
         } break;
         case OPCODE_RETURN: {
-            return_frame frame = pop(&global_interpreter->return_stack);
-            global_interpreter->current_function = frame.function;
-            global_interpreter->ip = frame.ip;
-            global_interpreter->sp = frame.sp;
-            global_interpreter->symbols_table_count = frame.symbols_count;
-            global_interpreter->depth--;
+            return_frame frame = pop(&current_interpreter->return_stack);
+            current_interpreter->current_function = frame.function;
+            current_interpreter->ip = frame.ip;
+            current_interpreter->sp = frame.sp;
+            current_interpreter->symbols_table_count = frame.symbols_count;
+            current_interpreter->depth--;
             return true;
         } break;
     }
@@ -1183,76 +2804,191 @@ bool step_bytecode() {
     return false;
 }
 
-bool step_program() {
-    if (global_interpreter->state == STATE_SLEEPING) {
-        return true;
+// Runs up to max_steps instructions. Runtime errors (and EXIT) longjmp back here so
+// the recovery point is set once per batch instead of once per instruction.
+bool interpreter_run(basic_ctx *ctx, size_t max_steps, size_t *steps_run) {
+    current_interpreter = ctx;
+    volatile int error_code = 0;
+    if ((error_code = setjmp(ctx->err_jmp)) != 0) {
+        if (error_code != -1) {
+            interpreter_log("\nexit from error from line %d\n", ctx->error_line);
+        }
+        // The step that failed isn't known past the longjmp, the program is over anyway
+        if (steps_run) {
+            *steps_run = max_steps;
+        }
+        return false;
     }
 
-    if (global_interpreter->ip >= global_interpreter->current_function->body.count) {
-        ERR("Something went wrong with ip");
+    gc_heap *gc = &ctx->gc;
+    size_t i = 0;
+    bool running = true;
+    for (; i < max_steps; i++) {
+        // Natives suspend the program by changing the state, it takes effect once they return
+        if (ctx->state != STATE_RUNNING) {
+            break;
+        }
+
+        if (ctx->arena->used >= gc->next_minor || gc->major_requested) {
+            gc_collect(gc->major_requested || ctx->arena->used >= gc->next_major);
+        }
+
+        if (ctx->ip >= ctx->current_function->body.count) {
+            ERR("Something went wrong with ip");
+        }
+        if (!step_bytecode()) {
+            running = false;
+            i++;
+            break;
+        }
     }
-    return step_bytecode();
+    if (steps_run) {
+        *steps_run = i;
+    }
+    return running;
 }
 
-void interpreter_destroy() {
-    global_interpreter = NULL;
-    arena_free(interpreter_arena);
-    interpreter_arena = NULL;
+bool interpreter_suspended(basic_ctx *ctx) {
+    return ctx->state == STATE_SLEEPING || ctx->state == STATE_WAITING;
 }
 
-void register_function(const char *name, void (*f)(), int arg_count) {
-    symbol *s = get_symbol_id(create_symbol(name, SYMBOL_FUNCTION_NATIVE));
-    s->as.native_func.function = f;
-    if (arg_count < 0) {
-        s->as.native_func.arg_count = 0;
-        s->as.native_func.variadic_arg_count = true;
-    } else {
-        s->as.native_func.arg_count = arg_count;
+bool step_program(basic_ctx *ctx) {
+    return interpreter_run(ctx, 1, NULL);
+}
+
+void interpreter_destroy(basic_ctx *ctx) {
+    if (current_interpreter == ctx) {
+        current_interpreter = NULL;
+    }
+    arena_free(ctx->arena);
+    arena_free(ctx->compile_arena);
+    arena_free(ctx->scratch);
+    // The context itself lives in its code arena
+    arena_free(ctx->code_arena);
+}
+
+// Signatures are written by hand next to the natives, a typo is a bug in the game
+uint8_t signature_types(char c) {
+    switch (c) {
+        case 'i':
+            return 1 << VAL_NUM;
+        case 'f':
+            return 1 << VAL_FIXED;
+        case 'n':
+            return 1 << VAL_NUM | 1 << VAL_FIXED;
+        case 's':
+            return 1 << VAL_STRING;
+        case 't':
+            return 1 << VAL_TABLE;
+        case 'v':
+            return 0xFF;
+        default:
+            assert(false && "Unknown type in native signature");
+            return 0;
+    }
+}
+
+void register_function(basic_ctx *ctx, const char *name, basic_native f, const char *signature) {
+    current_interpreter = ctx;
+    native_function native = {.name = name, .function = f};
+    const char *c = signature;
+    for (; *c != '\0' && *c != ':'; c++) {
+        if (*c == '*') {
+            // Only the last argument can repeat
+            assert(native.arg_count > 0 && (c[1] == '\0' || c[1] == ':'));
+            native.variadic = true;
+            native.arg_count--;
+            continue;
+        }
+        // Keep a slot for the repeated type of variadic natives
+        assert(native.arg_count < NATIVE_MAX_ARGS - 1);
+        native.arg_types[native.arg_count++] = signature_types(*c);
+    }
+    if (*c == ':') {
+        signature_types(c[1]);
+        native.returns = true;
     }
+
+    symbol *s = get_symbol_id(create_symbol(name, SYMBOL_FUNCTION_NATIVE));
+    s->as.native = ctx->natives.count;
+    arena_append(ctx->code_arena, &ctx->natives, native);
+}
+
+void register_variable_int(basic_ctx *ctx, const char *name, int value) {
+    current_interpreter = ctx;
+    create_symbol_from_value(name, NUM_VAL(value));
 }
 
-void register_variable_int(const char *name, int value) {
-    symbol *s = get_symbol_id(create_symbol(name, SYMBOL_VARIABLE_INT));
-    s->as.integer = value;
+void register_variable_string(basic_ctx *ctx, const char *name, const char *value) {
+    current_interpreter = ctx;
+    create_symbol_from_value(name, STRING_VAL(string_wrap(value)));
 }
 
-void register_variable_string(const char *name, const char *value) {
-    symbol *s = get_symbol_id(create_symbol(name, SYMBOL_VARIABLE_STRING));
-    s->as.string = value;
+void *basic_user_data(basic_ctx *ctx) {
+    return ctx->user_data;
 }
 
 void basic_push_int(int result) {
-    value v = {.type = VAL_NUM, .as.number = result};
-    arena_append(&global_interpreter->stack, v);
+    arena_append(interpreter_arena, &current_interpreter->stack, NUM_VAL(result));
 }
 
-void basic_push_string(const char *s) {
-    value v = {.type = VAL_STRING, .as.string = s};
-    arena_append(&global_interpreter->stack, v);
+void basic_push_value(value v) {
+    arena_append(interpreter_arena, &current_interpreter->stack, v);
 }
 
-int16_t basic_pop_value_num() {
-    value v = pop(&global_interpreter->stack);
-    if (v.type != VAL_NUM) {
+int32_t basic_pop_value_num() {
+    value v = pop(&current_interpreter->stack);
+    if (!IS_NUM(v)) {
         ERR("Expected numeric value on top of stack");
     }
-    return v.as.number;
+    return AS_NUM(v);
 }
 
 const char *basic_pop_value_string() {
-    value v = pop(&global_interpreter->stack);
-    if (v.type != VAL_STRING) {
+    value v = pop(&current_interpreter->stack);
+    if (!IS_STRING(v)) {
         ERR("Expected string value on top of stack");
     }
-    return v.as.string;
+    return string_cstr(AS_STRING(v));
+}
+
+// The helpers below are meant to be called by natives, while ctx is running
+value basic_string_value(basic_ctx *ctx, const char *s) {
+    current_interpreter = ctx;
+    return STRING_VAL(string_wrap(s));
+}
+
+const char *basic_value_cstr(basic_ctx *ctx, value v) {
+    current_interpreter = ctx;
+    return string_cstr(AS_STRING(v));
 }
 
-void basic_sleep(float seconds) {
+// Lets natives defined outside of the interpreter stop the program like a runtime error
+void basic_error(basic_ctx *ctx, const char *msg) {
+    current_interpreter = ctx;
+    ERR("%s", msg);
+}
+
+void basic_sleep(basic_ctx *ctx, float seconds) {
     if (seconds < 0) {
         seconds = 0;
     }
-    global_interpreter->wakeup_time = global_interpreter->time_elapsed + seconds;
-    should_go_to_sleep = true;
+    ctx->wakeup_time = ctx->time_elapsed + seconds;
+    ctx->state = STATE_SLEEPING;
+}
+
+void basic_wait(basic_ctx *ctx) {
+    ctx->state = STATE_WAITING;
+}
+
+void basic_resume(basic_ctx *ctx, value result) {
+    if (ctx->state != STATE_WAITING) {
+        return;
+    }
+    if (ctx->resume_has_result) {
+        ctx->stack.items[ctx->stack.count - 1] = result;
+    }
+    ctx->state = STATE_RUNNING;
 }
 
 #ifdef BASIC_TEST
@@ -1296,12 +3032,13 @@ int main(int argc, const char **argv) {
     const char default_content[] = {
 #embed "../assets/machines_impl/machine1/files/x"
     };
+    basic_ctx *ctx = interpreter_init(NULL, NULL, NULL);
     if (argc == 2 && argv[1][0] == '-') {
         const char *content = read_all_stdin();
-        if (!interpreter_init(content, NULL, NULL))
+        if (!interpreter_load(ctx, content))
             return 1;
     } else {
-        if (!interpreter_init(default_content, NULL, NULL))
+        if (!interpreter_load(ctx, default_content))
             return 1;
     }
 
@@ -1309,12 +3046,15 @@ int main(int argc, const char **argv) {
     long long last_time = timeInMilliseconds();
     while (true) {
         long long new_time = timeInMilliseconds();
-        advance_interpreter_time((new_time - last_time) / 1000.f);
-        if (!step_program())
+        advance_interpreter_time(ctx, (new_time - last_time) / 1000.f);
+        if (!interpreter_run(ctx, 1000, NULL))
             break;
         last_time = new_time;
+        if (interpreter_suspended(ctx)) {
+            usleep(1000);
+        }
     }
-    interpreter_destroy();
+    interpreter_destroy(ctx);
     return 0;
 }
 #endif
@@ -0,0 +1,38 @@
+#include "framebuffer.h"
+#include <assert.h>
+
+#define PALETTE_SIZE 16
+
+static struct {
+    Shader shader;
+} renderer;
+
+void framebuffer_renderer_init(const Color *palette, int palette_count) {
+    renderer.shader = LoadShader(0, "shaders/framebuffer.fs");
+    Vector4 colors[PALETTE_SIZE] = {0};
+    assert(palette_count <= PALETTE_SIZE);
+    for (int i = 0; i < palette_count; i++) {
+        colors[i] = ColorNormalize(palette[i]);
+    }
+    SetShaderValueV(renderer.shader, GetShaderLocation(renderer.shader, "palette"), colors, SHADER_UNIFORM_VEC4,
+                    PALETTE_SIZE);
+}
+
+Texture2D framebuffer_texture_load() {
+    static unsigned char empty[FB_SIZE];
+    Image pixels = {
+        .data = empty,
+        .width = FB_SIZE_WIDTH,
+        .height = FB_SIZE_HEIGHT,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+    };
+    return LoadTextureFromImage(pixels);
+}
+
+void framebuffer_draw(Texture2D texture, Rectangle dest) {
+    BeginShaderMode(renderer.shader);
+    Rectangle src = {0, 0, FB_SIZE_WIDTH, FB_SIZE_HEIGHT};
+    DrawTexturePro(texture, src, dest, (Vector2){0}, 0, WHITE);
+    EndShaderMode();
+}
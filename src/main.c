@@ -9,25 +9,32 @@
 #include "basic.h"
 #include "bootseq.h"
 #include "commands.h"
+#include "framebuffer.h"
 #include "raylib.h"
+#include "textmode.h"
+#include "workers.h"
 #define GLSL_VERSION 330
 
 const float WIDTH = 1280;
 const float HEIGHT = 720;
 
-#define FB_SIZE_WIDTH 80
-#define FB_SIZE_HEIGHT 60
-#define FB_SIZE (FB_SIZE_WIDTH * FB_SIZE_HEIGHT)
-
-#define MAX_LOG_COUNT 4096
 
 typedef struct terminal terminal;
+typedef struct exec_process exec_process;
 
 Shader terminal_shader = {0};
 RenderTexture2D target = {0};
 Font terminal_font = {0};
 
 const int font_size = 28;
+
+typedef enum { TERM_BG, TERM_FG, TERM_BLUE, TERM_GREEN, TERM_RED, TERM_YELLOW, TERM_PURPLE, TERM_COUNT } term_color;
+
+Color cs[TERM_COUNT] = {
+    [TERM_BG] = {0, 0, 0, 255},          [TERM_FG] = {255, 255, 255, 255}, [TERM_GREEN] = {0, 228, 48, 255},
+    [TERM_RED] = {240, 41, 55, 255},     [TERM_BLUE] = {0, 121, 241, 255}, [TERM_YELLOW] = {253, 249, 0, 255},
+    [TERM_PURPLE] = {200, 122, 255, 255}};
+
 terminal *all_terminals = NULL;
 terminal *active_term = NULL;
 int terminal_count = 0;
@@ -54,15 +61,77 @@ typedef struct {
     int offset;
 } help_process;
 
+typedef struct {
+    // 0 to list every job of the machine
+    int id;
+} mem_process;
+
 typedef struct {
     int fb[FB_SIZE];
 } test_process;
 
+// Text printed by a program and not yet in its terminal. Past EXEC_OUTPUT_LIMIT
+// bytes only the lines that fit on screen are kept, the others are counted.
 typedef struct {
+    char *items;
+    size_t count;
+    size_t capacity;
+    size_t skipped_lines;
+} exec_output;
+
+#define EXEC_OUTPUT_LIMIT (64 * 1024)
+
+// Programs run on the worker pool. Everything the main thread and the worker
+// share is either atomic, the published output or the triple buffered framebuffer.
+// While the job is parked the main thread owns the whole process. The file system
+// of the machine belongs to the main thread, OPEN parks to look the file up and
+// the lines of open_file are not freed while the job runs.
+struct exec_process {
     const char *filename;
-    int fb[2][FB_SIZE];
-    int fb_idx;
-} exec_process;
+    // Terminal the program was started from, its output goes there
+    terminal *term;
+    basic_ctx *ctx;
+    worker_job *job;
+    double start_time;
+    _Atomic bool cancel;
+    // Time given by the main thread and how much of it the program has seen
+    _Atomic uint64_t elapsed_us;
+    uint64_t consumed_us;
+    // The worker prints in output[output_back]. At the end of a slice it hands
+    // the buffer to the main thread through output_published, unless the main
+    // thread still has the other one, and -1 is stored back once it is read.
+    exec_output output[2];
+    int output_back;
+    _Atomic int output_published;
+    unsigned char fb[3][FB_SIZE];
+    // Holds fb[frames.front] once it is uploaded, loaded when the program is first drawn
+    Texture2D fb_texture;
+    bool fb_dirty;
+    // Written by PRINTAT, drawn over the framebuffer of the same frame
+    text_screen text[3];
+    triple_buffer frames;
+    // File opened by the program with OPEN, READLINE streams it from line_cursor
+    struct file_node *open_file;
+    int line_cursor;
+    // Command given to SYSTEM, the program waits until the main thread ran it
+    char *pending_command;
+    // Path given to OPEN, the program waits until the main thread looked it up
+    char *pending_open;
+
+    // Number in the job table of its machine
+    int id;
+    // Weight of the job when the scheduler splits the frame budget
+    int priority;
+    // Background jobs are reaped by the scheduler, the foreground one by exec_update
+    bool background;
+    bool finished;
+    // Steps the job may still run this frame, the worker parks it once they are spent
+    _Atomic int64_t budget;
+    _Atomic uint64_t steps;
+    // Set by mem, whoever owns the program fills mem and clears the flag
+    _Atomic bool mem_requested;
+    arena_stats mem;
+};
 
 typedef struct {
     int selected_index;
@@ -82,20 +151,21 @@ typedef struct {
     int capacity;
 } text_lines;
 
-void free_text_lines(text_lines *lines) {
+void free_text_lines(arena *a, text_lines *lines) {
     if (lines == NULL) {
         return;
     }
     for (int i = 0; i < lines->count; i++) {
-        free(lines->items[i]);
+        arena_free_node(a, lines->items[i]);
     }
-    free(lines->items);
+    arena_free_node(a, lines->items);
     lines->items = NULL;
     lines->count = 0;
     lines->capacity = 0;
 }
 
-text_lines text_split(char *content, char sep) {
+// Lines are copied in the arena, content is cut in place
+text_lines text_split(arena *a, char *content, char sep) {
     text_lines result = {0};
 
     if (content == NULL) {
@@ -107,7 +177,7 @@ text_lines text_split(char *content, char sep) {
     while (*s) {
         if (*s == sep) {
             *s = '\0';
-            append(&result, strdup(last));
+            arena_append(a, &result, arena_strdup(a, last));
             s++;
             last = s;
         } else {
@@ -156,27 +226,32 @@ const char *node_get_content(file_node *node) {
     return content;
 }
 
-void file_node_append_children(file_node *root, file_node *children) {
+void file_node_append_children(arena *a, file_node *root, file_node *children) {
     if (root->folder == false) {
         return;
     }
     children->parent = root;
-    append(&root->children, children);
+    arena_append(a, &root->children, children);
 }
 
-file_node *file_new(const char *name, text_lines lines) {
-    file_node *result = calloc(1, sizeof(*result));
+// Nodes live in the arena of their machine, like their name, lines and children lists
+file_node *node_new(arena *a, const char *name) {
+    file_node *result = arena_alloc(a, sizeof(*result));
     assert(result != NULL);
-    result->name = strdup(name);
+    memset(result, 0, sizeof(*result));
+    result->name = arena_strdup(a, name);
+    return result;
+}
+
+file_node *file_new(arena *a, const char *name, text_lines lines) {
+    file_node *result = node_new(a, name);
     result->lines = lines;
     result->content_size = get_lines_total_size(&result->lines);
     return result;
 }
 
-file_node *folder_new(const char *name) {
-    file_node *result = calloc(1, sizeof(*result));
-    assert(result != NULL);
-    result->name = strdup(name);
+file_node *folder_new(arena *a, const char *name) {
+    file_node *result = node_new(a, name);
     result->folder = true;
     return result;
 }
@@ -241,7 +316,7 @@ file_node *look_up_node(file_node *root, const char *path) {
     return root;
 }
 
-void file_node_append_folder_full_path(file_node *root, const char *path) {
+void file_node_append_folder_full_path(arena *a, file_node *root, const char *path) {
     int idx = 0;
     do {
         int next_directory = TextFindIndex(path + idx, "/");
@@ -251,10 +326,10 @@ void file_node_append_folder_full_path(file_node *root, const char *path) {
         idx += next_directory + 1;
     } while (true);
     file_node *parent = look_up_node(root, TextFormat("%.*s", idx, path));
-    file_node_append_children(parent, folder_new(path + idx));
+    file_node_append_children(a, parent, folder_new(a, path + idx));
 }
 
-void file_node_append_file_full_path(file_node *root, const char *path, text_lines lines) {
+void file_node_append_file_full_path(arena *a, file_node *root, const char *path, text_lines lines) {
     int idx = 0;
     do {
         int next_directory = TextFindIndex(path + idx, "/");
@@ -264,7 +339,7 @@ void file_node_append_file_full_path(file_node *root, const char *path, text_lin
         idx += next_directory + 1;
     } while (true);
     file_node *parent = look_up_node(root, TextFormat("%.*s", idx, path));
-    file_node_append_children(parent, file_new(path + idx, lines));
+    file_node_append_children(a, parent, file_new(a, path + idx, lines));
 }
 
 const char *get_file_full_path(file_node *node) {
@@ -329,19 +404,139 @@ typedef struct {
     file_node *pwd;
 } filesystem;
 
+// Terminal output is kept as bytes, the lines one after the other in a ring
+// with the oldest ones dropped to make room. A line never wraps around the end
+// of the ring so it can be drawn straight from it.
+#define SCROLLBACK_SIZE (128 * 1024)
+// Only reached by lines shorter than 16 bytes on average
+#define SCROLLBACK_MAX_LINES (SCROLLBACK_SIZE / 16)
+#define SCROLLBACK_MAX_LINE_LENGTH 4096
+
+typedef struct {
+    // Allocated with the first line, a terminal never written to costs nothing
+    char *text;
+    // Ring of the offsets of the lines in text, starting with the oldest one
+    uint32_t *lines;
+    size_t first;
+    size_t count;
+    // Offset right after the newest line
+    size_t head;
+} scrollback;
+
+const char *scrollback_line(const scrollback *sb, size_t index) {
+    return sb->text + sb->lines[(sb->first + index) % SCROLLBACK_MAX_LINES];
+}
+
+void scrollback_drop_oldest(scrollback *sb) {
+    sb->first = (sb->first + 1) % SCROLLBACK_MAX_LINES;
+    sb->count--;
+}
+
+// Gives the offset where size bytes can be written after the newest line,
+// dropping old lines until they fit
+size_t scrollback_reserve(scrollback *sb, size_t size) {
+    while (sb->count > 0) {
+        size_t oldest = sb->lines[sb->first];
+        if (sb->head > oldest) {
+            // Lines do not wrap, there is space after the newest and before the oldest
+            if (SCROLLBACK_SIZE - sb->head >= size) {
+                return sb->head;
+            }
+            if (oldest >= size) {
+                return 0;
+            }
+        } else if (oldest - sb->head >= size) {
+            return sb->head;
+        }
+        scrollback_drop_oldest(sb);
+    }
+    return 0;
+}
+
+void scrollback_commit(scrollback *sb, size_t offset, size_t length) {
+    sb->text[offset + length] = '\0';
+    sb->lines[(sb->first + sb->count) % SCROLLBACK_MAX_LINES] = offset;
+    sb->count++;
+    sb->head = offset + length + 1;
+}
+
+void scrollback_push(scrollback *sb, const char *text, size_t length) {
+    if (sb->text == NULL) {
+        sb->text = malloc(SCROLLBACK_SIZE + SCROLLBACK_MAX_LINES * sizeof(*sb->lines));
+        assert(sb->text != NULL);
+        sb->lines = (uint32_t *)(sb->text + SCROLLBACK_SIZE);
+    }
+    if (length > SCROLLBACK_MAX_LINE_LENGTH) {
+        length = SCROLLBACK_MAX_LINE_LENGTH;
+    }
+    if (sb->count == SCROLLBACK_MAX_LINES) {
+        scrollback_drop_oldest(sb);
+    }
+    size_t offset = scrollback_reserve(sb, length + 1);
+    memcpy(sb->text + offset, text, length);
+    scrollback_commit(sb, offset, length);
+}
+
+// Removes the newest line, its bytes stay until something else is pushed
+void scrollback_pop(scrollback *sb) {
+    sb->count--;
+    if (sb->count == 0) {
+        sb->head = 0;
+        return;
+    }
+    const char *newest = scrollback_line(sb, sb->count - 1);
+    sb->head = newest - sb->text + strlen(newest) + 1;
+}
+
+// Adds text at the end of the newest line. It grows in place unless it reaches
+// the end of the ring or the oldest line, then it is moved once.
+void scrollback_extend(scrollback *sb, const char *text, size_t length) {
+    if (sb->count == 0) {
+        scrollback_push(sb, text, length);
+        return;
+    }
+    size_t last = sb->lines[(sb->first + sb->count - 1) % SCROLLBACK_MAX_LINES];
+    size_t current = sb->head - last - 1;
+    if (current + length > SCROLLBACK_MAX_LINE_LENGTH) {
+        length = SCROLLBACK_MAX_LINE_LENGTH - current;
+    }
+    // Free bytes after the newest line go up to the end of the ring or to the oldest line
+    size_t oldest = sb->lines[sb->first];
+    size_t end = sb->head > oldest ? SCROLLBACK_SIZE : oldest;
+    if (sb->head + length <= end) {
+        memcpy(sb->text + sb->head - 1, text, length);
+        sb->head += length;
+        sb->text[sb->head - 1] = '\0';
+        return;
+    }
+    scrollback_pop(sb);
+    size_t offset = scrollback_reserve(sb, current + length + 1);
+    memmove(sb->text + offset, sb->text + last, current);
+    memcpy(sb->text + offset + current, text, length);
+    scrollback_commit(sb, offset, current + length);
+}
+
+void scrollback_clear(scrollback *sb) {
+    sb->first = 0;
+    sb->count = 0;
+    sb->head = 0;
+}
+
 typedef int (*process_init)(terminal *term, int argc, const char **argv);
 typedef int (*process_update)(terminal *term);
 typedef void (*process_render)(terminal *term);
 
 struct terminal {
+    // Files, metadata and history of the machine, all released at once by machine_reset
+    arena *arena;
+
     const char *title;
     const char *hostname;
     const char *ip;
 
-    const char *logs[MAX_LOG_COUNT];
-    size_t log_head;
-    size_t log_tail;
-    size_t log_count;
+    scrollback logs;
+    // Cells of the frame being rendered, filled by the render functions
+    text_screen screen;
 
     int scroll_offset;
 
@@ -364,6 +559,14 @@ struct terminal {
 
     filesystem fs;
     bool connected;
+
+    // Programs running on this machine, in the background or not
+    struct {
+        exec_process **items;
+        int count;
+        int capacity;
+    } jobs;
+    int last_job_id;
 };
 
 typedef struct {
@@ -394,11 +597,16 @@ typedef struct {
     XI(hostname, NULL)   \
     XIUR(mail, NULL)     \
     XI(shutdown, NULL)   \
+    XI(reboot, NULL)     \
     XI(clear, NULL)      \
     XI(ping, NULL)       \
     XIUR(edit, NULL)     \
     XIUR(help, NULL)     \
     XIUR(exec, NULL)     \
+    XI(ps, NULL)         \
+    XI(kill, NULL)       \
+    XIUR(fg, NULL)       \
+    XIU(mem, NULL)       \
     XIU(netscan, "ns")
 
 #define XI(n, a) int n##_init(terminal *term, int argc, const char **argv);
@@ -581,105 +789,185 @@ Vector2 V(int x, int y) {
     return (Vector2){x, y};
 }
 
-void DrawTerminalLine(const char *text, int line) {
-    DrawTextEx(terminal_font, text, S(0, font_size * line), font_size, 1, WHITE);
+// The screen starts one line above the first terminal line, the boot sequence writes there
+#define SCREEN_FIRST_LINE (-1)
+
+int screen_row(int line) {
+    return line - SCREEN_FIRST_LINE;
 }
 
-void DrawHoveredTerminalLine(const char *text, int line) {
-    DrawRectangleV(S(0, -5 + font_size * line), V(WIDTH, font_size + 5), WHITE);
-    DrawTextEx(terminal_font, text, S(0, font_size * line), font_size, 1, BLACK);
+void DrawTerminalLine(terminal *term, const char *text, int line) {
+    text_screen_print(&term->screen, 0, screen_row(line), text, TERM_FG);
 }
 
-void terminal_append_log(terminal *term, const char *text) {
-    if (term->log_count == MAX_LOG_COUNT) {
-        size_t oldest = (term->log_head + MAX_LOG_COUNT - term->log_count) % MAX_LOG_COUNT;
-        free((void *)term->logs[oldest]);
-    } else {
-        term->log_count++;
-    }
+void DrawHoveredTerminalLine(terminal *term, const char *text, int line) {
+    text_screen_print(&term->screen, 0, screen_row(line), text, TERM_FG);
+    text_screen_fill_attr(&term->screen, 0, screen_row(line), TEXT_SCREEN_COLUMNS, TERM_FG | TEXT_INVERSE);
+}
+
+// Everything written in the screen this frame goes to the GPU in one draw call
+void terminal_draw_screen(terminal *term) {
+    text_screen_draw(&term->screen, S(0, font_size * SCREEN_FIRST_LINE));
+    text_screen_clear(&term->screen);
+}
 
-    term->logs[term->log_head] = strdup(text);
-    term->log_head = (term->log_head + 1) % MAX_LOG_COUNT;
+void terminal_append_log(terminal *term, const char *text) {
+    scrollback_push(&term->logs, text, strlen(text));
 
-    if (term->log_count >= MAX_LINE_COUNT_PER_SCREEN) {
-        term->scroll_offset = term->log_count - MAX_LINE_COUNT_PER_SCREEN;
+    if (term->logs.count >= MAX_LINE_COUNT_PER_SCREEN) {
+        term->scroll_offset = term->logs.count - MAX_LINE_COUNT_PER_SCREEN;
     } else {
         term->scroll_offset = 0;
     }
 }
 
+// Moving the line can drop old ones, the view must stay within the lines left
+void terminal_log_extend(terminal *term, const char *text, size_t length) {
+    scrollback_extend(&term->logs, text, length);
+    int max_offset = term->logs.count >= MAX_LINE_COUNT_PER_SCREEN ? term->logs.count - MAX_LINE_COUNT_PER_SCREEN : 0;
+    if (term->scroll_offset > max_offset) {
+        term->scroll_offset = max_offset;
+    }
+}
+
 void terminal_log_append_text(terminal *term, const char *text) {
-    size_t last = (term->log_head == 0 ? MAX_LOG_COUNT : term->log_head) - 1;
-    const char *last_line = term->logs[last];
-    int current_len = strlen(last_line);
-    int new_text_len = strlen(text);
-    int new_len = current_len + new_text_len + 1;
-    char *new_line = malloc(new_len);
-    assert(new_line != NULL);
-    memset(new_line, 0, new_len);
-    strncpy(new_line, last_line, current_len);
-    strncat(new_line, text, new_text_len);
-    free((void *)last_line);
-    term->logs[last] = new_line;
+    terminal_log_extend(term, text, strlen(text));
 }
 
 void terminal_replace_last_line(terminal *term, const char *text) {
-    if (term->log_count == 0) {
-        terminal_append_log(term, text);
+    if (term->logs.count > 0) {
+        scrollback_pop(&term->logs);
+    }
+    terminal_append_log(term, text);
+}
+
+// Keeps the lines that fit on screen, in at most half of the limit so trimming
+// again waits for as many new bytes
+void exec_output_trim(exec_output *out) {
+    char *end = out->items + out->count;
+    char *cut = end - EXEC_OUTPUT_LIMIT / 2;
+    int lines = 0;
+    for (char *s = end - 1; s >= cut; s--) {
+        if (*s == '\n' && ++lines == MAX_LINE_COUNT_PER_SCREEN) {
+            cut = s + 1;
+            break;
+        }
+    }
+    if (lines < MAX_LINE_COUNT_PER_SCREEN) {
+        // Long lines, what is kept still starts at the beginning of one if it can
+        char *newline = memchr(cut, '\n', end - cut);
+        if (newline != NULL) {
+            cut = newline + 1;
+        }
+    }
+    for (char *s = out->items; (s = memchr(s, '\n', cut - s)) != NULL; s++) {
+        out->skipped_lines++;
+    }
+    out->count = end - cut;
+    memmove(out->items, cut, out->count);
+}
+
+// Called from the worker running the program, exec_flush_output moves the text
+// to the terminal once per frame
+void terminal_basic_print(basic_ctx *ctx, const char *text) {
+    exec_process *p = basic_user_data(ctx);
+    exec_output *out = &p->output[p->output_back];
+    size_t length = strlen(text);
+    if (out->count + length > out->capacity) {
+        size_t capacity = out->capacity == 0 ? 256 : out->capacity;
+        while (capacity < out->count + length) {
+            capacity *= 2;
+        }
+        out->items = realloc(out->items, capacity);
+        assert(out->items != NULL);
+        out->capacity = capacity;
+    }
+    memcpy(out->items + out->count, text, length);
+    out->count += length;
+    if (out->count > EXEC_OUTPUT_LIMIT) {
+        exec_output_trim(out);
+    }
+}
+
+// Runs on the worker at the end of a slice
+void exec_publish_output(exec_process *p) {
+    if (p->output[p->output_back].count == 0 && p->output[p->output_back].skipped_lines == 0) {
+        return;
+    }
+    if (atomic_load_explicit(&p->output_published, memory_order_acquire) != -1) {
         return;
     }
+    atomic_store_explicit(&p->output_published, p->output_back, memory_order_release);
+    p->output_back ^= 1;
+}
 
-    size_t last = (term->log_head == 0 ? MAX_LOG_COUNT : term->log_head) - 1;
-    char *last_line = (char *)term->logs[last];
-    size_t last_line_len = strlen(last_line) + 1;
-    size_t new_len = strlen(text) + 1;
-    if (last_line_len < new_len) {
-        term->logs[last] = realloc(last_line, new_len);
+void exec_ingest_output(terminal *term, exec_output *out) {
+    if (out->count == 0 && out->skipped_lines == 0) {
+        return;
     }
-    strncpy(last_line, text, last_line_len);
+    // The summary starts its own line even if the last ingest ended in the middle of one
+    if (out->skipped_lines > 0) {
+        const char *summary = TextFormat("(%zu lines skipped)", out->skipped_lines);
+        if (term->logs.count > 0 && scrollback_line(&term->logs, term->logs.count - 1)[0] == '\0') {
+            terminal_log_append_text(term, summary);
+        } else {
+            terminal_append_log(term, summary);
+        }
+        terminal_append_log(term, "");
+    }
+    const char *s = out->items;
+    const char *end = out->items + out->count;
+    const char *newline;
+    while ((newline = memchr(s, '\n', end - s)) != NULL) {
+        terminal_log_extend(term, s, newline - s);
+        terminal_append_log(term, "");
+        s = newline + 1;
+    }
+    terminal_log_extend(term, s, end - s);
+    out->count = 0;
+    out->skipped_lines = 0;
 }
 
-void terminal_basic_print(const char *text) {
-    // printf("%s", text);
-    if (*text == '\n') {
-        terminal_append_log(active_term, "");
-    } else {
-        terminal_append_log(active_term, text);
+void exec_flush_output(exec_process *p) {
+    int published = atomic_load_explicit(&p->output_published, memory_order_acquire);
+    if (published != -1) {
+        exec_ingest_output(p->term, &p->output[published]);
+        atomic_store_explicit(&p->output_published, -1, memory_order_release);
     }
 }
 
-void terminal_append_print(const char *text) {
-    // printf("[Basic]: %s", text);
-    terminal_log_append_text(active_term, text);
+// Only while the job is parked or done, what the worker has not published yet
+// comes after the published buffer
+void exec_flush_all_output(exec_process *p) {
+    exec_flush_output(p);
+    exec_ingest_output(p->term, &p->output[p->output_back]);
 }
 
 void terminal_append_input(terminal *term) {
     terminal_append_log(term, TextFormat("$%.*s", term->input_cursor, term->input));
-    append(&term->history, strdup(TextFormat("%.*s", term->input_cursor, term->input)));
+    arena_append(term->arena, &term->history, arena_strdup(term->arena, TextFormat("%.*s", term->input_cursor, term->input)));
     term->input_cursor = 0;
 }
 
-void terminal_render(const terminal *term) {
-    size_t available = term->log_count;
+void terminal_render(terminal *term) {
+    size_t available = term->logs.count;
 
     size_t start = term->scroll_offset;
     size_t end = fmin(start + MAX_LINE_COUNT_PER_SCREEN, available);
 
     for (size_t i = start; i < end; i++) {
-        size_t idx = (term->log_head + MAX_LOG_COUNT - term->log_count + i) % MAX_LOG_COUNT;
-        DrawTerminalLine(term->logs[idx], i - term->scroll_offset);
+        DrawTerminalLine(term, scrollback_line(&term->logs, i), i - term->scroll_offset);
     }
 }
 
 void terminal_render_prompt(terminal *term) {
-    int last_line_index = fmin(MAX_LINE_COUNT_PER_SCREEN, term->log_count);
+    int last_line_index = fmin(MAX_LINE_COUNT_PER_SCREEN, term->logs.count);
     const char *prompt_text = TextFormat("$%.*s", term->input_cursor, term->input);
-    DrawTerminalLine(prompt_text, last_line_index);
+    DrawTerminalLine(term, prompt_text, last_line_index);
     // TODO: Blink qu'après 1 seconde d'inactivité
     if ((int)GetTime() % 2 == 0) {
-        int x = MeasureTextEx(terminal_font, prompt_text, font_size, 1).x + 8;
-        int y = font_size * last_line_index + 4;
-        DrawRectangleV(S(x, y), V(10, font_size - 8), WHITE);
+        text_screen_fill_attr(&term->screen, term->input_cursor + 1, screen_row(last_line_index), 1,
+                              TERM_FG | TEXT_CURSOR);
     }
 }
 
@@ -832,11 +1120,25 @@ bool edit_append_line(edit_process *p, const char *content) {
     return true;
 }
 
-void edit_save_file(edit_process *p) {
-    free_text_lines(&p->node->lines);
+void edit_save_file(terminal *term, edit_process *p) {
+    // Jobs read the lines of their open file from a worker
+    for (int i = 0; i < term->jobs.count; i++) {
+        if (term->jobs.items[i]->open_file == p->node) {
+            p->tooltip_info = "In use!";
+            p->tooltip_info_remaining_time = 200;
+            return;
+        }
+    }
+    // Strings given by READLINE and LINE point into the lines of files opened
+    // before, they are only reclaimed once no program runs
+    if (term->jobs.count == 0) {
+        free_text_lines(term->arena, &p->node->lines);
+    } else {
+        p->node->lines = (text_lines){0};
+    }
     edit_line *line = p->root;
     while (line) {
-        append(&p->node->lines, strdup(line->content));
+        arena_append(term->arena, &p->node->lines, arena_strdup(term->arena, line->content));
         line = line->next;
     }
     p->tooltip_info = "Saved!";
@@ -971,7 +1273,7 @@ int edit_update(terminal *term) {
         return 1;
     }
     if (key_pressed_control(KEY_S)) {
-        edit_save_file(p);
+        edit_save_file(term, p);
     }
     if (key_pressed(KEY_RIGHT)) {
         if (p->cursor_col == p->selected_line->length) {
@@ -1087,7 +1389,7 @@ void edit_render(terminal *term) {
     int i = 0;
     int cursor_row = 0;
     while (line && i <= MAX_LINE_COUNT_PER_SCREEN - 1) {
-        DrawTextEx(terminal_font, line->content, S(0, font_size * i), font_size, 1, WHITE);
+        DrawTerminalLine(term, line->content, i);
         line = line->next;
         i++;
         if (line == p->selected_line) {
@@ -1096,38 +1398,34 @@ void edit_render(terminal *term) {
     }
     if (!p->search_open) {
         cursor_row = fmin(cursor_row, MAX_LINE_COUNT_PER_SCREEN - 1);
-        const char *current_line_content = p->selected_line->content;
         int col = fmin(p->selected_line->length, p->cursor_col);
-        Vector2 cursor_pos =
-            S(MeasureTextEx(terminal_font, TextFormat("%.*s", col, current_line_content), font_size, 1).x,
-              cursor_row * font_size);
-        DrawRectangleV(cursor_pos, V(font_size, font_size), WHITE);
-        DrawTextEx(terminal_font, TextFormat("%c", current_line_content[col]), cursor_pos, font_size, 1, BLACK);
-    } else {
-        Vector2 size = {WIDTH * 3 / 4.f, 100};
-        Vector2 center = {(WIDTH - size.x) / 2, (HEIGHT - size.y) / 2};
-        Rectangle rec = {center.x, center.y, size.x, size.y};
-        Rectangle outer = {rec.x - 4, rec.y - 4, rec.width + 8, rec.height + 8};
-        DrawRectangleRec(outer, WHITE);
-        DrawRectangleRec(rec, BLACK);
-        DrawTextEx(terminal_font, TextFormat("%.*s", p->search_cursor_position, p->search_input),
-                   (Vector2){rec.x + 16, rec.y + 24}, font_size * 2, 1, WHITE);
+        text_screen_fill_attr(&term->screen, col, screen_row(cursor_row), 1, TERM_FG | TEXT_INVERSE);
     }
 
     // Tooltip
-    Vector2 tooltip_position = S(0, font_size * MAX_LINE_COUNT_PER_SCREEN);
     const char *tooltip_content;
     if (p->search_result.count == 0) {
         tooltip_content = "[C-s] Save [C-c] Exit [C-f] Search";
     } else {
         tooltip_content = TextFormat("Search: %zu [C-n] Next [C-p] Previous", p->search_result.count);
     }
-    DrawTextEx(terminal_font, tooltip_content, tooltip_position, font_size, 1, WHITE);
-
+    DrawTerminalLine(term, tooltip_content, MAX_LINE_COUNT_PER_SCREEN);
     if (p->tooltip_info) {
-        int tooltip_info_length = MeasureTextEx(terminal_font, p->tooltip_info, font_size, 1).x;
-        Vector2 tooltip_info_position = S(WIDTH - 60 - tooltip_info_length, font_size * MAX_LINE_COUNT_PER_SCREEN);
-        DrawTextEx(terminal_font, p->tooltip_info, tooltip_info_position, font_size, 1, WHITE);
+        int column = TEXT_SCREEN_COLUMNS - 2 - strlen(p->tooltip_info);
+        text_screen_print(&term->screen, column, screen_row(MAX_LINE_COUNT_PER_SCREEN), p->tooltip_info, TERM_FG);
+    }
+
+    if (p->search_open) {
+        // The search box goes over the text
+        terminal_draw_screen(term);
+        Vector2 size = {WIDTH * 3 / 4.f, 100};
+        Vector2 center = {(WIDTH - size.x) / 2, (HEIGHT - size.y) / 2};
+        Rectangle rec = {center.x, center.y, size.x, size.y};
+        Rectangle outer = {rec.x - 4, rec.y - 4, rec.width + 8, rec.height + 8};
+        DrawRectangleRec(outer, WHITE);
+        DrawRectangleRec(rec, BLACK);
+        DrawTextEx(terminal_font, TextFormat("%.*s", p->search_cursor_position, p->search_input),
+                   (Vector2){rec.x + 16, rec.y + 24}, font_size * 2, 1, WHITE);
     }
 }
 
@@ -1180,59 +1478,176 @@ int netscan_update(terminal *term) {
     return 0;
 }
 
-void put_pixel(int *fb, int x, int y, int color) {
+void put_pixel(unsigned char *fb, int x, int y, int color) {
     if (x < 0 || x >= FB_SIZE_WIDTH || y < 0 || y >= FB_SIZE_HEIGHT)
         return;
     fb[y * FB_SIZE_WIDTH + x] = color;
 }
 
-typedef enum { TERM_BG, TERM_FG, TERM_BLUE, TERM_GREEN, TERM_RED, TERM_YELLOW, TERM_PURPLE, TERM_COUNT } term_color;
-
-Color cs[TERM_COUNT] = {
-    [TERM_BG] = {0, 0, 0, 255},          [TERM_FG] = {255, 255, 255, 255}, [TERM_GREEN] = {0, 228, 48, 255},
-    [TERM_RED] = {240, 41, 55, 255},     [TERM_BLUE] = {0, 121, 241, 255}, [TERM_YELLOW] = {253, 249, 0, 255},
-    [TERM_PURPLE] = {200, 122, 255, 255}};
-
-void render_framebuffer(int *fb) {
+// The texture only changes when the program rendered a new frame
+void render_framebuffer(exec_process *p) {
+    if (p->fb_texture.id == 0) {
+        p->fb_texture = framebuffer_texture_load();
+        p->fb_dirty = true;
+    }
+    if (p->fb_dirty) {
+        UpdateTexture(p->fb_texture, p->fb[p->frames.front]);
+        p->fb_dirty = false;
+    }
     int cell_width = (WIDTH - 80) / FB_SIZE_WIDTH;
     int cell_height = (HEIGHT - 60) / FB_SIZE_HEIGHT;
-    for (int y = 0; y < FB_SIZE_HEIGHT; y++) {
-        for (int x = 0; x < FB_SIZE_WIDTH; x++) {
-            Color c = cs[fb[y * FB_SIZE_WIDTH + x]];
-            DrawRectangle(40 + x * cell_width, 30 + y * cell_height, cell_width, cell_height, c);
-        }
+    framebuffer_draw(p->fb_texture, (Rectangle){40, 30, FB_SIZE_WIDTH * cell_width, FB_SIZE_HEIGHT * cell_height});
+}
+
+value put_pixel_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    exec_process *p = basic_user_data(ctx);
+    put_pixel(p->fb[p->frames.back], AS_NUM(argv[0]), AS_NUM(argv[1]), AS_NUM(argv[2]) % TERM_COUNT);
+    return BASIC_VOID;
+}
+
+value flip_render_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    exec_process *p = basic_user_data(ctx);
+    int drawn = p->frames.back;
+    triple_buffer_publish(&p->frames);
+    // The next frame starts as a copy of this one so programs only redraw what changes
+    memcpy(p->fb[p->frames.back], p->fb[drawn], sizeof(p->fb[drawn]));
+    p->text[p->frames.back] = p->text[drawn];
+    return BASIC_VOID;
+}
+
+value print_at_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    exec_process *p = basic_user_data(ctx);
+    unsigned char color = (unsigned)AS_NUM(argv[3]) % TERM_COUNT;
+    text_screen_print(&p->text[p->frames.back], AS_NUM(argv[0]), AS_NUM(argv[1]), basic_value_cstr(ctx, argv[2]),
+                      color);
+    return BASIC_VOID;
+}
+
+bool terminal_handle_command(terminal *term, const char *cmd);
+
+// Commands touch the terminals, they have to run on the main thread. The program
+// parks and jobs_schedule resumes it with the result of the command.
+value system_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    exec_process *p = basic_user_data(ctx);
+    p->pending_command = strdup(basic_value_cstr(ctx, argv[0]));
+    basic_wait(ctx);
+    return BASIC_VOID;
+}
+
+file_node *exec_open_file(exec_process *p) {
+    if (p->open_file == NULL) {
+        basic_error(p->ctx, "No file opened, use OPEN first");
     }
+    return p->open_file;
 }
 
-void put_pixel_fn() {
-    exec_process *p = (exec_process *)active_term->args;
-    int c = basic_pop_value_num();
-    int y = basic_pop_value_num();
-    int x = basic_pop_value_num();
-    put_pixel(p->fb[1 - p->fb_idx], x, y, c % TERM_COUNT);
-    basic_push_int(0);
+// Commands may change the file system while the program runs, the lookup is done
+// by exec_resume on the main thread
+value open_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    exec_process *p = basic_user_data(ctx);
+    p->pending_open = strdup(basic_value_cstr(ctx, argv[0]));
+    basic_wait(ctx);
+    return BASIC_VOID;
 }
 
-void flip_render_fn() {
-    exec_process *p = (exec_process *)active_term->args;
-    p->fb_idx = 1 - p->fb_idx;
-    active_term->render_not_ready = false;
+// Lines are handed to the program without being copied, only the cursor is kept here
+value readline_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    exec_process *p = basic_user_data(ctx);
+    file_node *file = exec_open_file(p);
+    if (p->line_cursor >= file->lines.count) {
+        return basic_string_value(ctx, "");
+    }
+    return basic_string_value(ctx, file->lines.items[p->line_cursor++]);
 }
 
-bool terminal_handle_command(const char *cmd);
+value eof_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    exec_process *p = basic_user_data(ctx);
+    file_node *file = exec_open_file(p);
+    return NUM_VAL(p->line_cursor >= file->lines.count);
+}
 
-void system_fn() {
-    const char *cmd = basic_pop_value_string();
-    int result = terminal_handle_command(cmd) == false ? 1 : 0;
-    basic_push_int(result);
-    basic_sleep(0.25f);
+value linecount_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    (void)argv;
+    exec_process *p = basic_user_data(ctx);
+    return NUM_VAL(exec_open_file(p)->lines.count);
 }
 
-double exec_start = 0;
+value line_fn(basic_ctx *ctx, int argc, const value *argv) {
+    (void)argc;
+    exec_process *p = basic_user_data(ctx);
+    int n = AS_NUM(argv[0]);
+    file_node *file = exec_open_file(p);
+    if (n < 0 || n >= file->lines.count) {
+        basic_error(ctx, TextFormat("Line %d is out of range, file has %d lines", n, file->lines.count));
+    }
+    return basic_string_value(ctx, file->lines.items[n]);
+}
+
+#define EXEC_SLICE_STEPS 10000
+// The game is built without optimisations, a worker runs about 15M steps per
+// second so this is roughly what it gets through in a 60 fps frame
+#define EXEC_FRAME_BUDGET_PER_WORKER (1 << 18)
+#define EXEC_DEFAULT_PRIORITY 4
+#define EXEC_MAX_PRIORITY 9
+
+// Runs on a worker, a slice is short so cancelling and time updates are seen quickly
+job_status exec_step(void *data) {
+    exec_process *p = data;
+    if (atomic_load(&p->cancel)) {
+        return JOB_DONE;
+    }
+    int64_t budget = atomic_load(&p->budget);
+    if (budget <= 0) {
+        return JOB_PARK;
+    }
+    size_t steps = budget < EXEC_SLICE_STEPS ? budget : EXEC_SLICE_STEPS;
+    uint64_t elapsed = atomic_load(&p->elapsed_us);
+    advance_interpreter_time(p->ctx, (elapsed - p->consumed_us) / 1e6f);
+    p->consumed_us = elapsed;
+    // A program that sleeps or waits stops early, only what it ran is charged
+    size_t steps_run = 0;
+    bool running = interpreter_run(p->ctx, steps, &steps_run);
+    atomic_fetch_sub(&p->budget, steps_run);
+    atomic_fetch_add(&p->steps, steps_run);
+    exec_publish_output(p);
+    if (!running) {
+        return JOB_DONE;
+    }
+    if (atomic_load(&p->mem_requested)) {
+        p->mem = basic_get_memory_stats(p->ctx);
+        atomic_store(&p->mem_requested, false);
+    }
+    return interpreter_suspended(p->ctx) ? JOB_PARK : JOB_CONTINUE;
+}
+
+// Returned by an init that started a job instead of taking over the terminal
+#define PROCESS_DETACHED 2
 
 int exec_init(terminal *t, int argc, const char **argv) {
-    if (argc != 2) {
-        terminal_append_log(t, "exec <file>");
+    bool background = false;
+    if (argc > 1 && strcmp(argv[argc - 1], "&") == 0) {
+        background = true;
+        argc--;
+    }
+    int priority = EXEC_DEFAULT_PRIORITY;
+    if (argc == 4 && strcmp(argv[1], "-p") == 0) {
+        priority = TextToInteger(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc != 2 || priority < 1 || priority > EXEC_MAX_PRIORITY) {
+        terminal_append_log(t, "exec (-p <1-9>) <file> (&)");
         return 1;
     }
     const char *filepath = argv[1];
@@ -1244,59 +1659,392 @@ int exec_init(terminal *t, int argc, const char **argv) {
     exec_process *p = malloc(sizeof(*p));
     assert(p != NULL);
     p->filename = strdup(filepath);
-    p->fb_idx = 0;
-    memset(p->fb[0], 0, sizeof(*p->fb[0]) * FB_SIZE);
-    memset(p->fb[1], 0, sizeof(*p->fb[1]) * FB_SIZE);
+    p->term = t;
+    p->open_file = NULL;
+    p->line_cursor = 0;
+    p->pending_command = NULL;
+    p->pending_open = NULL;
+    p->priority = priority;
+    p->background = background;
+    p->finished = false;
+    atomic_store(&p->budget, 0);
+    atomic_store(&p->steps, 0);
+    atomic_store(&p->mem_requested, false);
+    memset(&p->mem, 0, sizeof(p->mem));
+    atomic_store(&p->cancel, false);
+    atomic_store(&p->elapsed_us, 0);
+    p->consumed_us = 0;
+    memset(p->output, 0, sizeof(p->output));
+    p->output_back = 0;
+    atomic_store(&p->output_published, -1);
+    memset(p->fb, 0, sizeof(p->fb));
+    p->fb_texture = (Texture2D){0};
+    p->fb_dirty = false;
+    memset(p->text, 0, sizeof(p->text));
+    triple_buffer_init(&p->frames);
     const char *program = node_get_content(file);
-    // TODO: Avoid additional new line at the end of execution
-    terminal_append_log(active_term, "");
 
-    exec_start = GetTime();
-    if (!interpreter_init(program, &terminal_basic_print, &terminal_append_print)) {
+    p->start_time = GetTime();
+    basic_ctx *ctx = interpreter_init(&terminal_basic_print, &terminal_basic_print, p);
+    p->ctx = ctx;
+    register_function(ctx, "PUTPIXEL", put_pixel_fn, "iii");
+    register_function(ctx, "RENDER", flip_render_fn, "");
+    register_function(ctx, "PRINTAT", print_at_fn, "iisi");
+    register_function(ctx, "SYSTEM", system_fn, "s:i");
+    register_function(ctx, "OPEN", open_fn, "s:i");
+    register_function(ctx, "READLINE", readline_fn, ":s");
+    register_function(ctx, "EOF", eof_fn, ":i");
+    register_function(ctx, "LINECOUNT", linecount_fn, ":i");
+    register_function(ctx, "LINE", line_fn, "i:s");
+
+    register_variable_int(ctx, "COLOR_BG", TERM_BG);
+    register_variable_int(ctx, "COLOR_FG", TERM_FG);
+    register_variable_int(ctx, "COLOR_BLUE", TERM_BLUE);
+    register_variable_int(ctx, "COLOR_GREEN", TERM_GREEN);
+    register_variable_int(ctx, "COLOR_RED", TERM_RED);
+    register_variable_int(ctx, "COLOR_YELLOW", TERM_YELLOW);
+    register_variable_int(ctx, "COLOR_PURPLE", TERM_PURPLE);
+    if (!interpreter_load(ctx, program)) {
+        // The compile errors were printed in the output buffer, they still have to be shown
+        exec_ingest_output(t, &p->output[0]);
+        free(p->output[0].items);
+        free((void *)p->filename);
+        free(p);
+        free((void *)program);
         return 1;
     }
-    register_function("PUTPIXEL", put_pixel_fn, 3);
-    register_function("RENDER", flip_render_fn, 0);
-    register_function("COLOR_RED", flip_render_fn, 0);
-    register_function("SYSTEM", system_fn, 1);
-
-    register_variable_int("COLOR_BG", TERM_BG);
-    register_variable_int("COLOR_FG", TERM_FG);
-    register_variable_int("COLOR_BLUE", TERM_BLUE);
-    register_variable_int("COLOR_GREEN", TERM_GREEN);
-    register_variable_int("COLOR_RED", TERM_RED);
-    register_variable_int("COLOR_YELLOW", TERM_YELLOW);
-    register_variable_int("COLOR_PURPLE", TERM_PURPLE);
-
-    t->render_not_ready = true;
-    t->args = p;
     free((void *)program);
-    return 0;
+
+    p->id = ++t->last_job_id;
+    append(&t->jobs, p);
+    if (background) {
+        terminal_append_log(t, TextFormat("[%d] %s", p->id, p->filename));
+    } else {
+        t->render_not_ready = true;
+        t->args = p;
+    }
+    // TODO: Avoid additional new line at the end of execution
+    terminal_append_log(t, "");
+    // The job has no budget yet, it parks until jobs_schedule gives it some
+    p->job = workers_submit(exec_step, p);
+    return background ? PROCESS_DETACHED : 0;
+}
+
+// Only called while the job is parked, the main thread owns the program
+void exec_resume(exec_process *p) {
+    // Whatever the program printed before it stopped comes before the output of its command
+    exec_flush_all_output(p);
+    if (p->pending_command != NULL) {
+        int result = terminal_handle_command(p->term, p->pending_command) == false ? 1 : 0;
+        free(p->pending_command);
+        p->pending_command = NULL;
+        basic_resume(p->ctx, NUM_VAL(result));
+    }
+    if (p->pending_open != NULL) {
+        file_node *file = look_up_node(p->term->fs.pwd, p->pending_open);
+        free(p->pending_open);
+        p->pending_open = NULL;
+        bool found = file != NULL && !file->folder;
+        p->open_file = found ? file : NULL;
+        p->line_cursor = 0;
+        basic_resume(p->ctx, NUM_VAL(found));
+    }
+    uint64_t elapsed = atomic_load(&p->elapsed_us);
+    advance_interpreter_time(p->ctx, (elapsed - p->consumed_us) / 1e6f);
+    p->consumed_us = elapsed;
+}
+
+// A parked program only needs a worker again once it can continue, a cancelled
+// one is woken up so the worker finishes it
+bool exec_runnable(exec_process *p) {
+    return !worker_job_parked(p->job) || !interpreter_suspended(p->ctx) || atomic_load(&p->cancel);
+}
+
+// The worker is done with the program, print what it wrote before stopping
+void exec_reap(terminal *term, int index) {
+    exec_process *p = term->jobs.items[index];
+    exec_flush_all_output(p);
+    free(p->output[0].items);
+    free(p->output[1].items);
+    // A cancelled program is not resumed
+    free(p->pending_command);
+    free(p->pending_open);
+    if (p->fb_texture.id != 0) {
+        UnloadTexture(p->fb_texture);
+    }
+    worker_job_free(p->job);
+    interpreter_destroy(p->ctx);
+    memmove(&term->jobs.items[index], &term->jobs.items[index + 1],
+            (term->jobs.count - index - 1) * sizeof(*term->jobs.items));
+    term->jobs.count--;
+
+    bool cancelled = atomic_load(&p->cancel);
+    if (!cancelled) {
+        printf("Execution took %f\n", GetTime() - p->start_time);
+    }
+    if (p->background) {
+        terminal_append_log(term, TextFormat("[%d] %s %s", p->id, cancelled ? "Killed" : "Done", p->filename));
+        free((void *)p->filename);
+        free(p);
+    } else {
+        // exec_update returns once it sees it, the main loop frees p with the terminal args
+        p->finished = true;
+    }
+}
+
+// Runs every frame on the main thread. Jobs of every machine keep running while
+// another terminal is shown, each runnable one gets a share of the frame budget
+// proportional to its priority.
+void jobs_schedule() {
+    uint64_t frame_us = GetFrameTime() * 1e6f;
+    int total_priority = 0;
+    for (int i = 0; i < terminal_count; i++) {
+        terminal *t = &all_terminals[i];
+        for (int j = 0; j < t->jobs.count; j++) {
+            exec_process *p = t->jobs.items[j];
+            atomic_fetch_add(&p->elapsed_us, frame_us);
+            exec_flush_output(p);
+            if (worker_job_done(p->job)) {
+                exec_reap(t, j);
+                j--;
+                continue;
+            }
+            if (worker_job_parked(p->job)) {
+                exec_resume(p);
+            }
+            if (exec_runnable(p)) {
+                total_priority += p->priority;
+            }
+        }
+    }
+    if (total_priority == 0) {
+        return;
+    }
+
+    int64_t budget = (int64_t)EXEC_FRAME_BUDGET_PER_WORKER * workers_count();
+    for (int i = 0; i < terminal_count; i++) {
+        terminal *t = &all_terminals[i];
+        for (int j = 0; j < t->jobs.count; j++) {
+            exec_process *p = t->jobs.items[j];
+            if (!exec_runnable(p)) {
+                continue;
+            }
+            // Unspent steps are not carried over, a job that slept does not get a burst
+            atomic_store(&p->budget, budget * p->priority / total_priority);
+            if (worker_job_parked(p->job)) {
+                worker_job_wake(p->job);
+            }
+        }
+    }
+}
+
+exec_process *find_job(terminal *term, int id) {
+    for (int i = 0; i < term->jobs.count; i++) {
+        if (term->jobs.items[i]->id == id) {
+            return term->jobs.items[i];
+        }
+    }
+    return NULL;
 }
 
 int exec_update(terminal *term) {
     exec_process *p = (exec_process *)term->args;
     if (term->process_should_exit) {
-        interpreter_destroy();
-        free((void *)p->filename);
+        atomic_store(&p->cancel, true);
+    }
+    if (triple_buffer_acquire(&p->frames)) {
+        term->render_not_ready = false;
+        p->fb_dirty = true;
+    }
+    if (!p->finished) {
+        term->title = TextFormat("Executing %s", p->filename);
+        return 0;
+    }
+    free((void *)p->filename);
+    return 1;
+}
+
+void exec_render(terminal *term) {
+    exec_process *p = (exec_process *)term->args;
+    render_framebuffer(p);
+    term->screen = p->text[p->frames.front];
+}
+
+int ps_init(terminal *term, int argc, const char **argv) {
+    (void)argc;
+    (void)argv;
+    terminal_append_log(term, "ID  PRI STATE    KSTEPS  NAME");
+    for (int i = 0; i < term->jobs.count; i++) {
+        exec_process *p = term->jobs.items[i];
+        // Only a parked program can be looked at from the main thread
+        const char *state = worker_job_parked(p->job) && interpreter_suspended(p->ctx) ? "sleeping" : "running";
+        unsigned long long ksteps = atomic_load(&p->steps) / 1000;
+        terminal_append_log(term, TextFormat("%-3d %-3d %-8s %-7llu %s%s", p->id, p->priority, state, ksteps,
+                                             p->filename, p->background ? " &" : ""));
+    }
+    return 0;
+}
+
+int kill_init(terminal *term, int argc, const char **argv) {
+    if (argc != 2) {
+        terminal_append_log(term, "kill <id>");
         return 1;
     }
-    advance_interpreter_time(GetFrameTime());
-    for (int i = 0; i < 100000; i++) {
-        if (!step_program()) {
-            free((void *)p->filename);
-            interpreter_destroy();
-            printf("Execution took %f\n", GetTime() - exec_start);
-            return 1;
+    exec_process *p = find_job(term, TextToInteger(argv[1]));
+    if (p == NULL) {
+        terminal_append_log(term, TextFormat("No job %s", argv[1]));
+        return 1;
+    }
+    atomic_store(&p->cancel, true);
+    return 0;
+}
+
+void format_bytes(char *buffer, size_t size, size_t bytes) {
+    if (bytes >= 1024 * 1024) {
+        snprintf(buffer, size, "%.1fM", bytes / (1024.f * 1024.f));
+    } else if (bytes >= 1024) {
+        snprintf(buffer, size, "%.1fK", bytes / 1024.f);
+    } else {
+        snprintf(buffer, size, "%zu", bytes);
+    }
+}
+
+// The stats are taken by the worker running each program, mem_update waits for them
+int mem_init(terminal *term, int argc, const char **argv) {
+    if (argc > 2) {
+        terminal_append_log(term, "mem (id)");
+        return 1;
+    }
+    int id = argc == 2 ? TextToInteger(argv[1]) : 0;
+    if (id != 0 && find_job(term, id) == NULL) {
+        terminal_append_log(term, TextFormat("No job %s", argv[1]));
+        return 1;
+    }
+    if (term->jobs.count == 0) {
+        terminal_append_log(term, "No program running");
+        return 1;
+    }
+    for (int i = 0; i < term->jobs.count; i++) {
+        exec_process *p = term->jobs.items[i];
+        if (id == 0 || p->id == id) {
+            atomic_store(&p->mem_requested, true);
         }
     }
-    term->title = TextFormat("Executing %s", p->filename);
+    mem_process *m = malloc(sizeof(*m));
+    assert(m != NULL);
+    m->id = id;
+    term->args = m;
     return 0;
 }
 
-void exec_render(terminal *term) {
-    exec_process *p = (exec_process *)term->args;
-    render_framebuffer(p->fb[p->fb_idx]);
+void mem_print_job(terminal *term, exec_process *p, bool details) {
+    char used[16], peak[16], limit[16];
+    format_bytes(used, sizeof(used), p->mem.used);
+    format_bytes(limit, sizeof(limit), p->mem.limit);
+    format_bytes(peak, sizeof(peak), p->mem.counters.peak);
+    if (!details) {
+        terminal_append_log(term, TextFormat("%-3d %-7s %-7s %-7s %3d%% %s", p->id, used,
+                                             p->mem.has_counters ? peak : "-", limit, p->mem.fragmentation,
+                                             p->filename));
+        return;
+    }
+    char committed[16], largest[16];
+    format_bytes(committed, sizeof(committed), p->mem.committed);
+    format_bytes(largest, sizeof(largest), p->mem.largest_free);
+    terminal_append_log(term, p->filename);
+    terminal_append_log(term, TextFormat("used %s of %s, %s committed", used, limit, committed));
+    terminal_append_log(term, TextFormat("%zu free blocks, largest %s", p->mem.free_blocks, largest));
+    terminal_append_log(term, TextFormat("fragmentation %d%%", p->mem.fragmentation));
+    if (!p->mem.has_counters) {
+        return;
+    }
+    terminal_append_log(term, TextFormat("peak %s, %zu allocs, %zu frees", peak, p->mem.counters.allocs,
+                                         p->mem.counters.frees));
+    terminal_append_log(term, "SIZE    ALLOCS    BYTES");
+    for (size_t class = 0; class < ARENA_CLASS_COUNT; class++) {
+        if (p->mem.counters.class_allocs[class] == 0) {
+            continue;
+        }
+        char size[16], bytes[16];
+        format_bytes(size, sizeof(size), arena_class_size(class));
+        format_bytes(bytes, sizeof(bytes), p->mem.counters.class_bytes[class]);
+        terminal_append_log(term, TextFormat("%s%-6s %-9zu %s", class < ARENA_SMALL_CLASSES ? " " : ">", size,
+                                             p->mem.counters.class_allocs[class], bytes));
+    }
+}
+
+int mem_update(terminal *term) {
+    mem_process *m = (mem_process *)term->args;
+    if (term->process_should_exit) {
+        return 1;
+    }
+    bool pending = false;
+    for (int i = 0; i < term->jobs.count; i++) {
+        exec_process *p = term->jobs.items[i];
+        if (!atomic_load(&p->mem_requested) || worker_job_done(p->job)) {
+            continue;
+        }
+        // A parked program is not touched by any worker, the stats can be taken here
+        if (worker_job_parked(p->job)) {
+            p->mem = basic_get_memory_stats(p->ctx);
+            atomic_store(&p->mem_requested, false);
+        } else {
+            pending = true;
+        }
+    }
+    if (pending) {
+        term->title = "Collecting memory stats";
+        return 0;
+    }
+
+    if (m->id == 0) {
+        terminal_append_log(term, "ID  USED    PEAK    LIMIT   FRAG NAME");
+    }
+    for (int i = 0; i < term->jobs.count; i++) {
+        exec_process *p = term->jobs.items[i];
+        // Finished programs are reaped on the next frame, their stats were never taken
+        if (worker_job_done(p->job)) {
+            continue;
+        }
+        if (m->id == 0 || p->id == m->id) {
+            mem_print_job(term, p, m->id != 0);
+        }
+    }
+    return 1;
+}
+
+int fg_init(terminal *term, int argc, const char **argv) {
+    if (argc > 2) {
+        terminal_append_log(term, "fg (id)");
+        return 1;
+    }
+    exec_process *p = NULL;
+    if (argc == 2) {
+        p = find_job(term, TextToInteger(argv[1]));
+    } else {
+        // Without an id, the most recent background job
+        for (int i = term->jobs.count - 1; i >= 0 && p == NULL; i--) {
+            if (term->jobs.items[i]->background) {
+                p = term->jobs.items[i];
+            }
+        }
+    }
+    if (p == NULL || !p->background) {
+        terminal_append_log(term, "No background job");
+        return 1;
+    }
+    p->background = false;
+    term->args = p;
+    term->render_not_ready = true;
+    return 0;
+}
+
+int fg_update(terminal *term) {
+    return exec_update(term);
+}
+
+void fg_render(terminal *term) {
+    exec_render(term);
 }
 
 typedef struct {
@@ -1548,9 +2296,9 @@ int create_init(terminal *term, int argc, const char **argv) {
     }
     // TODO: Don't use argv[2] directly because it allows naming files "a/b"
     if (strcmp(argv[1], "d") == 0) {
-        file_node_append_children(term->fs.pwd, folder_new(argv[2]));
+        file_node_append_children(term->arena, term->fs.pwd, folder_new(term->arena, argv[2]));
     } else if (strcmp(argv[1], "f") == 0) {
-        file_node_append_children(term->fs.pwd, file_new(argv[2], (text_lines){0}));
+        file_node_append_children(term->arena, term->fs.pwd, file_new(term->arena, argv[2], (text_lines){0}));
     } else {
         terminal_append_log(term, "create (d|f) <path>");
         return 1;
@@ -1636,9 +2384,9 @@ void machines_render(terminal *term) {
         terminal *t = p->machines.items[i];
         const char *text = TextFormat("%s%s@%s", t == active_term ? "> " : "", t->hostname, t->ip);
         if (i == p->selected_index) {
-            DrawHoveredTerminalLine(text, i);
+            DrawHoveredTerminalLine(term, text, i);
         } else {
-            DrawTerminalLine(text, i);
+            DrawTerminalLine(term, text, i);
         }
     }
 }
@@ -1661,14 +2409,8 @@ int clear_init(terminal *term, int argc, const char **argv) {
     (void)argc;
     (void)argv;
 
-    for (size_t i = 0; i < active_term->log_count; i++) {
-        size_t index = (term->log_head + MAX_LOG_COUNT - term->log_count + i) % MAX_LOG_COUNT;
-        free((void *)term->logs[index]);
-        term->logs[index] = NULL;
-    }
-    term->log_head = 0;
-    term->log_tail = 0;
-    term->log_count = 0;
+    scrollback_clear(&term->logs);
+    term->scroll_offset = 0;
     return 0;
 }
 
@@ -1759,7 +2501,7 @@ void help_render(terminal *term) {
                1, WHITE);
 }
 
-bool terminal_handle_command(const char *cmd) {
+bool terminal_handle_command(terminal *term, const char *cmd) {
     int argc = 0;
     const char **argv = TextSplit(cmd, ' ', &argc);
     if (argc == 0 || *argv[0] == '\0') {
@@ -1777,20 +2519,32 @@ bool terminal_handle_command(const char *cmd) {
         }
     }
 
+    // Programs run commands with SYSTEM while the terminal may be in use, a command
+    // taking over the terminal would replace the process already there. A
+    // background exec leaves the terminal to its process.
+    bool detached = c != NULL && c->init == exec_init && strcmp(argv[argc - 1], "&") == 0;
+    if (c != NULL && c->update != NULL && term->process_update != NULL && !detached) {
+        terminal_append_log(term, "Terminal is busy");
+        return false;
+    }
     if (c != NULL) {
-        if (c->init(active_term, argc, argv) != 0) {
+        int status = c->init(term, argc, argv);
+        if (status == PROCESS_DETACHED) {
+            return true;
+        }
+        if (status != 0) {
             return false;
         }
         if (c->update != NULL) {
-            active_term->process_update = c->update;
+            term->process_update = c->update;
         }
         if (c->render != NULL) {
-            active_term->process_render = c->render;
+            term->process_render = c->render;
         }
         return true;
     }
-    terminal_append_log(active_term, TextFormat("Unknown command : %s", argv[0]));
-    terminal_append_log(active_term, "Type 'help' to see available commands");
+    terminal_append_log(term, TextFormat("Unknown command : %s", argv[0]));
+    terminal_append_log(term, "Type 'help' to see available commands");
     return false;
 }
 
@@ -1798,7 +2552,7 @@ void terminal_exec_input(terminal *term) {
     term->history_ptr = 0;
     const char *input = TextFormat("%.*s", term->input_cursor, term->input);
     terminal_append_input(term);
-    terminal_handle_command(input);
+    terminal_handle_command(term, input);
 }
 
 const char *terminal_autocomplete_command(const char *input) {
@@ -1876,11 +2630,20 @@ bool TextEmpty(const char *s) {
     return true;
 }
 
-void load_machines() {
+// Reads assets/machines. With reload set only that machine is filled again,
+// the others and the networks are left as they are.
+void parse_machines(terminal *reload) {
     char *file_content = LoadFileText("assets/machines");
-    text_lines lines = text_split(file_content, '\n');
-    terminal_count = TextToInteger(lines.items[0]);
-    all_terminals = calloc(terminal_count, sizeof(terminal));
+    // The file is only needed while parsing, everything kept is copied in the machine arenas
+    arena *scratch = arena_default();
+    text_lines lines = text_split(scratch, file_content, '\n');
+    if (reload == NULL) {
+        terminal_count = TextToInteger(lines.items[0]);
+        all_terminals = calloc(terminal_count, sizeof(terminal));
+        for (int i = 0; i < terminal_count; i++) {
+            all_terminals[i].arena = arena_default();
+        }
+    }
     int machine_idx = -1;
 
     bool parsing_files = false;
@@ -1893,6 +2656,10 @@ void load_machines() {
         if (TextEmpty(lines.items[i])) {
             continue;
         }
+        terminal *current = &all_terminals[machine_idx];
+        if (reload != NULL && current != reload) {
+            continue;
+        }
         if (parsing_files) {
             if (lines.items[i][0] == '-') {
                 lines.items[i] += 2;
@@ -1905,31 +2672,31 @@ void load_machines() {
                 const char *content = lines.items[i] + split_index + 1;
                 if (file[strlen(file) - 1] == '/') {
                     file[strlen(file) - 1] = '\0';
-                    file_node_append_folder_full_path(all_terminals[machine_idx].fs.root, file);
+                    file_node_append_folder_full_path(current->arena, current->fs.root, file);
                 } else {
                     char *content_with_new_lines = TextReplace(content, "\\n", "\n");
-                    text_lines file_lines = text_split(strdup(content_with_new_lines), '\n');
-                    file_node_append_file_full_path(all_terminals[machine_idx].fs.root, file, file_lines);
+                    text_lines file_lines = text_split(current->arena, content_with_new_lines, '\n');
+                    free(content_with_new_lines);
+                    file_node_append_file_full_path(current->arena, current->fs.root, file, file_lines);
                 }
             }
             continue;
         }
-        terminal *current = &all_terminals[machine_idx];
         int split_index = TextFindIndex(lines.items[i], ": ");
         if (split_index) {
             const char *key = TextSubtext(lines.items[i], 0, split_index);
             const char *value = lines.items[i] + split_index + 2;
             if (strcmp(key, "hostname") == 0) {
-                current->hostname = strdup(value);
+                current->hostname = arena_strdup(current->arena, value);
             } else if (strcmp(key, "ip") == 0) {
                 if (!is_ip_format(value)) {
                     printf("Wrong format for ip : '%s'\n", value);
                     exit(1);
                 }
-                current->ip = strdup(value);
+                current->ip = arena_strdup(current->arena, value);
             } else if (strcmp(key, "files") == 0) {
                 parsing_files = true;
-                current->fs.root = folder_new("/");
+                current->fs.root = folder_new(current->arena, "/");
                 current->fs.root->parent = current->fs.root;
                 current->fs.pwd = current->fs.root;
             } else if (strcmp(key, "network") == 0) {
@@ -1937,6 +2704,10 @@ void load_machines() {
                     printf("IP should be set before network for machine %d\n", machine_idx);
                     exit(1);
                 }
+                // Links between machines are kept when one of them is reset
+                if (reload != NULL) {
+                    continue;
+                }
                 while (*value) {
                     if (*value >= '0' && *value <= '9') {
                         network_append_machine(&networks[*value - '0'], current);
@@ -1949,9 +2720,52 @@ void load_machines() {
             }
         }
     }
+    arena_free(scratch);
     free(file_content);
 }
 
+void load_machines() {
+    parse_machines(NULL);
+}
+
+// Puts the machine back as it was at startup. Nothing in its arena may be in
+// use, so no program can be running on it.
+void machine_reset(terminal *term) {
+    arena_reset(term->arena);
+    term->hostname = NULL;
+    term->ip = NULL;
+    term->fs = (filesystem){0};
+    term->history.items = NULL;
+    term->history.count = 0;
+    term->history.capacity = 0;
+    term->history_ptr = 0;
+    parse_machines(term);
+
+    // Networks point to the ip of the machine, it was copied again
+    for (int i = 0; i < MAX_NETWORK_COUNT; i++) {
+        for (int j = 0; j < networks[i].node_count; j++) {
+            if (networks[i].nodes[j].term == term) {
+                networks[i].nodes[j].ip = term->ip;
+            }
+        }
+    }
+}
+
+int reboot_init(terminal *term, int argc, const char **argv) {
+    (void)argv;
+    if (argc != 1) {
+        terminal_append_log(term, "reboot");
+        return 1;
+    }
+    if (term->jobs.count > 0) {
+        terminal_append_log(term, "Programs are still running, stop them with kill");
+        return 1;
+    }
+    machine_reset(term);
+    terminal_append_log(term, TextFormat("%s rebooted", term->hostname));
+    return 0;
+}
+
 int bootup_sequence_idx = -1;
 float bootup_sequence_line_time_left = 1000;
 
@@ -1976,8 +2790,6 @@ int bootup_sequence_update(terminal *term) {
 }
 
 void bootup_sequence_render(terminal *term) {
-    (void)term;
-
     int real_line_count = 0;
     for (int i = 0; i <= bootup_sequence_idx; i++) {
         bootup_sequence_line *line = bootseq_get_line(i);
@@ -2007,16 +2819,14 @@ void bootup_sequence_render(terminal *term) {
         if (seq_line->override_previous == false) {
             line++;
         }
-        DrawTerminalLine(seq_line->content, line - 1);
+        DrawTerminalLine(term, seq_line->content, line - 1);
     }
 
     if (bootup_sequence_idx >= 0) {
         bootup_sequence_line *seq_line = bootseq_get_line(bootup_sequence_idx);
         if ((int)GetTime() % 2 == 0) {
-            int x_offset = seq_line->content[0] == '\0' ? 0 : 8;
-            int x = x_offset + MeasureTextEx(terminal_font, seq_line->content, font_size, 1).x;
-            int y = font_size * (line - 1);
-            DrawRectangleV(S(x, y), V(10, font_size), WHITE);
+            text_screen_fill_attr(&term->screen, strlen(seq_line->content), screen_row(line - 1), 1,
+                                  TERM_FG | TEXT_CURSOR);
         }
     }
 }
@@ -2032,6 +2842,8 @@ int main() {
     target = LoadRenderTexture(WIDTH, HEIGHT);
     SetTextureFilter(target.texture, TEXTURE_FILTER_POINT);
     terminal_font = LoadFont("fonts/C64_TrueType_v1.2.1-STYLE/fonts/C64_Pro_Mono-STYLE.ttf");
+    text_renderer_init(terminal_font, font_size, cs, TERM_COUNT);
+    framebuffer_renderer_init(cs, TERM_COUNT);
 
     int time = GetShaderLocation(terminal_shader, "time");
     int width = GetShaderLocation(terminal_shader, "renderWidth");
@@ -2040,6 +2852,7 @@ int main() {
     SetShaderValue(terminal_shader, height, &HEIGHT, SHADER_ATTRIB_FLOAT);
 
     load_machines();
+    workers_init();
 
     active_term = &all_terminals[0];
     active_term->process_update = bootup_sequence_update;
@@ -2078,11 +2891,11 @@ int main() {
                     active_term->input_cursor = strlen(active_term->input);
                     active_term->history_ptr++;
                 }
-                // active_term->scroll_offset = fmax(0, active_term->log_count - MAX_LINE_COUNT_PER_SCREEN);
+                // active_term->scroll_offset = fmax(0, active_term->logs.count - MAX_LINE_COUNT_PER_SCREEN);
             }
             if (key_pressed_control(KEY_DOWN)) {
                 active_term->scroll_offset =
-                    fmin(active_term->scroll_offset + 1, fmax(0, active_term->log_count - MAX_LINE_COUNT_PER_SCREEN));
+                    fmin(active_term->scroll_offset + 1, fmax(0, active_term->logs.count - MAX_LINE_COUNT_PER_SCREEN));
             } else if (key_pressed(KEY_DOWN)) {
                 if (active_term->history_ptr > 1) {
                     active_term->history_ptr--;
@@ -2093,7 +2906,7 @@ int main() {
                     active_term->history_ptr = 0;
                     active_term->input_cursor = 0;
                 }
-                // active_term->scroll_offset = fmax(0, active_term->log_count - MAX_LINE_COUNT_PER_SCREEN);
+                // active_term->scroll_offset = fmax(0, active_term->logs.count - MAX_LINE_COUNT_PER_SCREEN);
             }
             if (key_pressed(KEY_TAB)) {
                 terminal_autocomplete_input(active_term);
@@ -2103,6 +2916,7 @@ int main() {
             }
         }
 
+        jobs_schedule();
         if (active_term->process_update != NULL) {
             active_term->process_should_exit = key_pressed_control(KEY_C);
             if (active_term->process_update(active_term)) {
@@ -2135,12 +2949,13 @@ int main() {
             }
             if (active_term->process_update == NULL) {
                 bool is_scrolling =
-                    active_term->log_count >= MAX_LINE_COUNT_PER_SCREEN &&
-                    (active_term->scroll_offset != (int)active_term->log_count - MAX_LINE_COUNT_PER_SCREEN);
+                    active_term->logs.count >= MAX_LINE_COUNT_PER_SCREEN &&
+                    (active_term->scroll_offset != (int)active_term->logs.count - MAX_LINE_COUNT_PER_SCREEN);
                 if (!is_scrolling) {
                     terminal_render_prompt(active_term);
                 }
             }
+            terminal_draw_screen(active_term);
         }
         EndTextureMode();
 
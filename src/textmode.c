@@ -0,0 +1,110 @@
+#include "textmode.h"
+#include <assert.h>
+#include <string.h>
+
+#define ATLAS_COLUMNS 16
+#define ATLAS_ROWS 8
+
+static struct {
+    Shader shader;
+    // Glyph of each ASCII code in a grid of cells, codes without a glyph stay empty
+    Texture2D atlas;
+    // One texel per cell of the screen being drawn
+    Texture2D cells;
+    int atlas_loc;
+    int cell_width;
+    int cell_height;
+} renderer;
+
+void text_screen_clear(text_screen *s) {
+    memset(s->cells, 0, sizeof(s->cells));
+}
+
+int text_screen_print(text_screen *s, int column, int row, const char *text, unsigned char attr) {
+    if (row < 0 || row >= TEXT_SCREEN_ROWS) {
+        return column;
+    }
+    for (const unsigned char *c = (const unsigned char *)text; *c && column < TEXT_SCREEN_COLUMNS; c++) {
+        // One cell per UTF-8 character, the font only has ASCII
+        if ((*c & 0xC0) == 0x80) {
+            continue;
+        }
+        if (column >= 0) {
+            unsigned char glyph = *c < 0x80 ? *c : '?';
+            s->cells[row][column].glyph = glyph < ' ' ? ' ' : glyph;
+            s->cells[row][column].attr = attr;
+        }
+        column++;
+    }
+    return column;
+}
+
+void text_screen_fill_attr(text_screen *s, int column, int row, int count, unsigned char attr) {
+    if (row < 0 || row >= TEXT_SCREEN_ROWS) {
+        return;
+    }
+    for (int i = column < 0 ? 0 : column; i < column + count && i < TEXT_SCREEN_COLUMNS; i++) {
+        s->cells[row][i].attr = attr;
+    }
+}
+
+void text_renderer_init(Font font, int font_size, const Color *palette, int palette_count) {
+    renderer.cell_width = MeasureTextEx(font, "A", font_size, 1).x + 1;
+    renderer.cell_height = font_size;
+
+    RenderTexture2D target = LoadRenderTexture(ATLAS_COLUMNS * renderer.cell_width, ATLAS_ROWS * renderer.cell_height);
+    BeginTextureMode(target);
+    ClearBackground(BLANK);
+    for (int c = ' ' + 1; c < 0x7F; c++) {
+        Vector2 position = {(c % ATLAS_COLUMNS) * renderer.cell_width, (c / ATLAS_COLUMNS) * renderer.cell_height};
+        DrawTextCodepoint(font, c, position, font_size, WHITE);
+    }
+    EndTextureMode();
+    // Render textures are upside down
+    Image atlas = LoadImageFromTexture(target.texture);
+    ImageFlipVertical(&atlas);
+    renderer.atlas = LoadTextureFromImage(atlas);
+    SetTextureFilter(renderer.atlas, TEXTURE_FILTER_POINT);
+    UnloadImage(atlas);
+    UnloadRenderTexture(target);
+
+    static text_cell empty[TEXT_SCREEN_ROWS * TEXT_SCREEN_COLUMNS];
+    Image cells = {
+        .data = empty,
+        .width = TEXT_SCREEN_COLUMNS,
+        .height = TEXT_SCREEN_ROWS,
+        .mipmaps = 1,
+        .format = PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA,
+    };
+    renderer.cells = LoadTextureFromImage(cells);
+
+    renderer.shader = LoadShader(0, "shaders/textmode.fs");
+    renderer.atlas_loc = GetShaderLocation(renderer.shader, "atlas");
+    float grid_size[2] = {TEXT_SCREEN_COLUMNS, TEXT_SCREEN_ROWS};
+    SetShaderValue(renderer.shader, GetShaderLocation(renderer.shader, "gridSize"), grid_size, SHADER_UNIFORM_VEC2);
+    float cell_size[2] = {renderer.cell_width, renderer.cell_height};
+    SetShaderValue(renderer.shader, GetShaderLocation(renderer.shader, "cellSize"), cell_size, SHADER_UNIFORM_VEC2);
+    Vector4 colors[TEXT_COLOR_MASK + 1] = {0};
+    assert(palette_count <= TEXT_COLOR_MASK + 1);
+    for (int i = 0; i < palette_count; i++) {
+        colors[i] = ColorNormalize(palette[i]);
+    }
+    SetShaderValueV(renderer.shader, GetShaderLocation(renderer.shader, "palette"), colors, SHADER_UNIFORM_VEC4,
+                    TEXT_COLOR_MASK + 1);
+}
+
+Vector2 text_renderer_cell_size() {
+    return (Vector2){renderer.cell_width, renderer.cell_height};
+}
+
+void text_screen_draw(const text_screen *s, Vector2 position) {
+    UpdateTexture(renderer.cells, s->cells);
+    BeginShaderMode(renderer.shader);
+    // Samplers other than the drawn texture are only bound for the next batch
+    SetShaderValueTexture(renderer.shader, renderer.atlas_loc, renderer.atlas);
+    Rectangle src = {0, 0, TEXT_SCREEN_COLUMNS, TEXT_SCREEN_ROWS};
+    Rectangle dest = {position.x, position.y, TEXT_SCREEN_COLUMNS * renderer.cell_width,
+                      TEXT_SCREEN_ROWS * renderer.cell_height};
+    DrawTexturePro(renderer.cells, src, dest, (Vector2){0}, 0, WHITE);
+    EndShaderMode();
+}
@@ -0,0 +1,149 @@
+#include "workers.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void triple_buffer_init(triple_buffer *b) {
+    b->back = 0;
+    atomic_store(&b->published, 1);
+    b->front = 2;
+}
+
+void triple_buffer_publish(triple_buffer *b) {
+    int previous = atomic_exchange_explicit(&b->published, b->back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+    b->back = previous & ~TRIPLE_BUFFER_FRESH;
+}
+
+bool triple_buffer_acquire(triple_buffer *b) {
+    if (!(atomic_load_explicit(&b->published, memory_order_relaxed) & TRIPLE_BUFFER_FRESH)) {
+        return false;
+    }
+    int previous = atomic_exchange_explicit(&b->published, b->front, memory_order_acq_rel);
+    b->front = previous & ~TRIPLE_BUFFER_FRESH;
+    return true;
+}
+
+struct worker_job {
+    job_step step;
+    void *data;
+    struct worker_job *next;
+    _Atomic bool parked;
+    _Atomic bool done;
+};
+
+// Jobs are queued in FIFO order, a worker takes the first one, steps it and puts
+// it back at the end so every running program gets slices in turn.
+// Parked jobs are in no list, worker_job_wake puts them back in the queue.
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    worker_job *runnable_head;
+    worker_job *runnable_tail;
+
+    size_t worker_count;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void pool_push_runnable(worker_job *job) {
+    job->next = NULL;
+    if (pool.runnable_tail == NULL) {
+        pool.runnable_head = job;
+    } else {
+        pool.runnable_tail->next = job;
+    }
+    pool.runnable_tail = job;
+}
+
+static worker_job *pool_pop_runnable() {
+    worker_job *job = pool.runnable_head;
+    if (job != NULL) {
+        pool.runnable_head = job->next;
+        if (pool.runnable_head == NULL) {
+            pool.runnable_tail = NULL;
+        }
+    }
+    return job;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (true) {
+        worker_job *job = pool_pop_runnable();
+        if (job == NULL) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&pool.lock);
+        job_status status = job->step(job->data);
+        pthread_mutex_lock(&pool.lock);
+
+        if (status == JOB_DONE) {
+            atomic_store(&job->done, true);
+        } else if (status == JOB_PARK) {
+            atomic_store(&job->parked, true);
+        } else {
+            pool_push_runnable(job);
+        }
+    }
+    return NULL;
+}
+
+void workers_init() {
+    // The main thread mostly waits for vsync, every core can run programs
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    pool.worker_count = cores < 1 ? 1 : cores;
+    for (size_t i = 0; i < pool.worker_count; i++) {
+        pthread_t thread;
+        int result = pthread_create(&thread, NULL, worker_main, NULL);
+        assert(result == 0);
+        pthread_detach(thread);
+    }
+}
+
+size_t workers_count() {
+    return pool.worker_count;
+}
+
+worker_job *workers_submit(job_step step, void *data) {
+    worker_job *job = malloc(sizeof(*job));
+    assert(job != NULL);
+    job->step = step;
+    job->data = data;
+    atomic_store(&job->parked, false);
+    atomic_store(&job->done, false);
+
+    pthread_mutex_lock(&pool.lock);
+    pool_push_runnable(job);
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    return job;
+}
+
+bool worker_job_done(worker_job *job) {
+    return atomic_load(&job->done);
+}
+
+bool worker_job_parked(worker_job *job) {
+    return atomic_load(&job->parked);
+}
+
+void worker_job_wake(worker_job *job) {
+    pthread_mutex_lock(&pool.lock);
+    if (atomic_load(&job->parked)) {
+        atomic_store(&job->parked, false);
+        pool_push_runnable(job);
+        pthread_cond_signal(&pool.wake);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Only valid once the job is done, no worker holds it anymore
+void worker_job_free(worker_job *job) {
+    assert(worker_job_done(job));
+    free(job);
+}
@@ -0,0 +1,36 @@
+import os, sys
+import subprocess
+import time
+
+root = 'tests/bench/'
+binary = './build/basic_bench'
+runs = 5
+
+benches = sorted(f for f in os.listdir(root) if f.endswith('.basic'))
+if len(sys.argv) > 1:
+    benches = [b for b in benches if any(arg in b for arg in sys.argv[1:])]
+
+for bench in benches:
+    with open(os.path.join(root, bench)) as f:
+        program = f.read()
+    # A first line '# expect: <output>' is compared with what the bench prints
+    expected = None
+    first_line = program.split('\n', 1)[0]
+    if first_line.startswith('# expect:'):
+        expected = first_line[len('# expect:'):].strip()
+
+    timings = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        p = subprocess.run([binary, '-'], input=program, capture_output=True, text=True)
+        timings.append(time.perf_counter() - start)
+        if p.returncode != 0:
+            print(f"\033[91m{bench}: exited with {p.returncode}\033[0m")
+            print(p.stdout + p.stderr)
+            break
+        if expected is not None and p.stdout.strip() != expected:
+            print(f"\033[91m{bench}: expected {expected} but got {p.stdout.strip()}\033[0m")
+            break
+    else:
+        best = min(timings) * 1000
+        print(f"{bench:<32} {best:8.2f} ms")